@@ -0,0 +1,715 @@
+// binary logger, the hooks write compact records into per thread rings and a background thread writes them to disk
+// a record is a timestamp, a format id and the raw arguments, formatting happens offline in binlog_decode.cpp
+// header only, the asi, binlog_check.cpp and binlog_decode.cpp share it
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <type_traits>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#endif
+
+// "S4BL"
+#define BINLOG_MAGIC 0x4c423453u
+// bump whenever the file format changes
+#define BINLOG_VERSION 2
+
+// per thread ring size in 8 byte slots, a power of 2
+#define BINLOG_RING_SLOTS 8192
+// threads beyond this many don't get a ring, what they log is counted as dropped
+#define BINLOG_MAX_THREADS 32
+#define BINLOG_MAX_FORMATS 1024
+// longer string arguments are cut
+#define BINLOG_MAX_STRING 511
+#define BINLOG_MAX_FORMAT_LENGTH 4096
+#define BINLOG_FLUSH_MS 50
+
+// format ids below BINLOG_FIRST_FORMAT are records the writer adds itself
+enum binlog_builtin_format{
+	// id, argument types, format string, defines an id before its first use
+	BINLOG_FORMAT_DEFINITION = 0,
+	// thread index, os thread id, once per thread before its first record
+	BINLOG_FORMAT_THREAD,
+	// thread index, records dropped so far on it, whenever that grows
+	BINLOG_FORMAT_DROPPED,
+	BINLOG_FIRST_FORMAT = 16,
+};
+
+// what a record is about, each has its own level
+enum binlog_category{
+	BINLOG_CATEGORY_LIMITER = 0,
+	BINLOG_CATEGORY_MOVEMENT,
+	BINLOG_CATEGORY_SPREAD,
+	BINLOG_CATEGORY_FOV,
+	BINLOG_CATEGORY_CONFIG,
+	BINLOG_CATEGORY_HOOKS,
+	BINLOG_CATEGORY_COUNT
+};
+static const char *binlog_category_names[BINLOG_CATEGORY_COUNT] = {
+	"limiter",
+	"movement",
+	"spread",
+	"fov",
+	"config",
+	"hooks",
+};
+
+// a category logs its records up to its level
+enum binlog_level{
+	BINLOG_LEVEL_OFF = 0,
+	BINLOG_LEVEL_INFO,
+	// per call and per frame records
+	BINLOG_LEVEL_VERBOSE,
+	BINLOG_LEVEL_COUNT
+};
+static const char *binlog_level_names[BINLOG_LEVEL_COUNT + 1] = {
+	"off",
+	"info",
+	"verbose",
+	NULL
+};
+
+// one bit per category and level above off, a call site tests its own with a single and
+#define BINLOG_BIT(category, level) (1u << ((category) * (BINLOG_LEVEL_COUNT - 1) + (level) - 1))
+static_assert(BINLOG_CATEGORY_COUNT * (BINLOG_LEVEL_COUNT - 1) <= 32, "binlog_mask is out of bits");
+
+// the file starts with this, then records back to back
+struct binlog_file_header{
+	uint32_t magic;
+	uint32_t version;
+	// the logger's clock and the wall clock at the same moment, to put timestamps on a calendar
+	uint64_t clock_ns;
+	int64_t unix_time;
+	uint64_t reserved;
+};
+
+// followed by the arguments, 8 bytes each, strings are their length then their bytes padded to 8
+struct binlog_record{
+	uint64_t timestamp_ns;
+	uint16_t format;
+	// including this header
+	uint16_t slots;
+	uint16_t thread;
+	uint8_t category;
+	uint8_t level;
+};
+#define BINLOG_HEADER_SLOTS (sizeof(struct binlog_record) / 8)
+static_assert(sizeof(struct binlog_record) == 16, "binlog_record layout changed, bump BINLOG_VERSION");
+static_assert(sizeof(struct binlog_file_header) == 32, "binlog_file_header layout changed, bump BINLOG_VERSION");
+
+// one character per argument in a definition's types
+enum binlog_arg_type{
+	BINLOG_ARG_INT = 'i',
+	BINLOG_ARG_UINT = 'u',
+	BINLOG_ARG_DOUBLE = 'd',
+	BINLOG_ARG_POINTER = 'p',
+	BINLOG_ARG_STRING = 's',
+};
+
+// single producer, the thread it belongs to, single consumer, the writer
+// positions count slots and wrap freely, only their difference matters
+struct binlog_ring{
+	alignas(64) uint32_t head;
+	// records that didn't fit, written by the producer only
+	uint32_t dropped;
+	alignas(64) uint32_t tail;
+	uint32_t index;
+	uint64_t os_thread_id;
+	uint64_t slots[BINLOG_RING_SLOTS];
+};
+
+struct binlog_format{
+	const char *fmt;
+	const char *types;
+};
+
+// the levels of every category folded into bits, checked before anything else at every call site
+static uint32_t binlog_mask = 0;
+static uint64_t (*binlog_now_ns)() = NULL;
+
+static struct binlog_ring *binlog_rings[BINLOG_MAX_THREADS];
+static uint32_t binlog_ring_count = 0;
+// logged by threads without a ring
+static uint32_t binlog_orphan_dropped = 0;
+static struct binlog_format binlog_formats[BINLOG_MAX_FORMATS];
+static uint32_t binlog_format_count = 0;
+
+#ifdef _WIN32
+static DWORD binlog_tls_index = TLS_OUT_OF_INDEXES;
+#else
+static __thread struct binlog_ring *binlog_thread_ring = NULL;
+#endif
+
+// bit is BINLOG_BIT of the call site, a constant
+__attribute__((always_inline)) static inline bool binlog_on(uint32_t bit){
+	return (__atomic_load_n(&binlog_mask, __ATOMIC_RELAXED) & bit) != 0;
+}
+
+// levels has one entry per category
+static uint32_t binlog_mask_for(const int *levels){
+	uint32_t mask = 0;
+	for(int category = 0;category < BINLOG_CATEGORY_COUNT;category++){
+		for(int level = BINLOG_LEVEL_INFO;level <= levels[category] && level < BINLOG_LEVEL_COUNT;level++){
+			mask |= BINLOG_BIT(category, level);
+		}
+	}
+	return mask;
+}
+
+static void binlog_set_mask(uint32_t mask){
+	__atomic_store_n(&binlog_mask, mask, __ATOMIC_RELAXED);
+}
+
+static struct binlog_ring *binlog_new_ring(){
+	uint32_t index = __atomic_fetch_add(&binlog_ring_count, 1, __ATOMIC_RELAXED);
+	if(index >= BINLOG_MAX_THREADS){
+		return NULL;
+	}
+	#ifdef _WIN32
+	struct binlog_ring *ring = (struct binlog_ring *)_aligned_malloc(sizeof(struct binlog_ring), 64);
+	#else
+	struct binlog_ring *ring = (struct binlog_ring *)aligned_alloc(64, sizeof(struct binlog_ring));
+	#endif
+	if(ring == NULL){
+		return NULL;
+	}
+	memset(ring, 0, sizeof(struct binlog_ring));
+	ring->index = index;
+	#ifdef _WIN32
+	ring->os_thread_id = GetCurrentThreadId();
+	#else
+	ring->os_thread_id = (uint64_t)pthread_self();
+	#endif
+	__atomic_store_n(&binlog_rings[index], ring, __ATOMIC_RELEASE);
+	return ring;
+}
+
+// the calling thread's ring, made on its first record
+__attribute__((always_inline)) static inline struct binlog_ring *binlog_ring(){
+	#ifdef _WIN32
+	struct binlog_ring *ring = (struct binlog_ring *)TlsGetValue(binlog_tls_index);
+	if(__builtin_expect(ring == NULL, 0)){
+		ring = binlog_new_ring();
+		TlsSetValue(binlog_tls_index, ring);
+	}
+	#else
+	struct binlog_ring *ring = binlog_thread_ring;
+	if(__builtin_expect(ring == NULL, 0)){
+		ring = binlog_new_ring();
+		binlog_thread_ring = ring;
+	}
+	#endif
+	return ring;
+}
+
+template<typename T> constexpr char binlog_type(){
+	using U = std::decay_t<T>;
+	if constexpr(std::is_same_v<U, char *> || std::is_same_v<U, const char *>){
+		return BINLOG_ARG_STRING;
+	}else if constexpr(std::is_floating_point_v<U>){
+		return BINLOG_ARG_DOUBLE;
+	}else if constexpr(std::is_pointer_v<U> || std::is_member_pointer_v<U> || std::is_null_pointer_v<U>){
+		return BINLOG_ARG_POINTER;
+	}else if constexpr(std::is_enum_v<U> || std::is_signed_v<U>){
+		return BINLOG_ARG_INT;
+	}else{
+		return BINLOG_ARG_UINT;
+	}
+}
+
+static inline size_t binlog_string_length(const char *s){
+	return strnlen(s != NULL ? s : "(null)", BINLOG_MAX_STRING);
+}
+
+template<typename T> __attribute__((always_inline)) static inline uint32_t binlog_arg_slots(const T &value){
+	if constexpr(binlog_type<T>() == BINLOG_ARG_STRING){
+		return 1 + (binlog_string_length(value) + 7) / 8;
+	}else{
+		return 1;
+	}
+}
+
+template<typename T> __attribute__((always_inline)) static inline uint32_t binlog_put(uint64_t *slots, uint32_t pos, const T &value){
+	const uint32_t mask = BINLOG_RING_SLOTS - 1;
+	constexpr char type = binlog_type<T>();
+	if constexpr(type == BINLOG_ARG_STRING){
+		const char *s = value;
+		s = s != NULL ? s : "(null)";
+		size_t len = binlog_string_length(s);
+		slots[pos++ & mask] = len;
+		for(size_t i = 0;i < len;i += 8){
+			uint64_t chunk = 0;
+			memcpy(&chunk, s + i, len - i < 8 ? len - i : 8);
+			slots[pos++ & mask] = chunk;
+		}
+		return pos;
+	}else if constexpr(type == BINLOG_ARG_DOUBLE){
+		double d = value;
+		memcpy(&slots[pos & mask], &d, sizeof(double));
+	}else if constexpr(type == BINLOG_ARG_POINTER){
+		slots[pos & mask] = (uint64_t)(uintptr_t)value;
+	}else if constexpr(type == BINLOG_ARG_INT){
+		slots[pos & mask] = (uint64_t)(int64_t)value;
+	}else{
+		slots[pos & mask] = (uint64_t)value;
+	}
+	return pos + 1;
+}
+
+// entries are published by their fmt, the writer stops at the first one still NULL
+static uint16_t binlog_register(const char *fmt, const char *types){
+	uint32_t index = __atomic_fetch_add(&binlog_format_count, 1, __ATOMIC_RELAXED);
+	if(index >= BINLOG_MAX_FORMATS - BINLOG_FIRST_FORMAT){
+		return 0;
+	}
+	binlog_formats[index].types = types;
+	__atomic_store_n(&binlog_formats[index].fmt, fmt, __ATOMIC_RELEASE);
+	return index + BINLOG_FIRST_FORMAT;
+}
+
+// format is the call site's id, 0 until it registered its format
+// never blocks, drops the record when the ring is full
+template<typename... Args> static inline void binlog_write(uint16_t *format, int category, int level, const char *fmt, const Args &...args){
+	uint16_t id = __atomic_load_n(format, __ATOMIC_ACQUIRE);
+	if(__builtin_expect(id == 0, 0)){
+		static const char types[] = {binlog_type<Args>()..., '\0'};
+		id = binlog_register(fmt, types);
+		if(id == 0){
+			return;
+		}
+		__atomic_store_n(format, id, __ATOMIC_RELEASE);
+	}
+
+	struct binlog_ring *ring = binlog_ring();
+	if(__builtin_expect(ring == NULL, 0)){
+		__atomic_fetch_add(&binlog_orphan_dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	uint32_t slot_count = BINLOG_HEADER_SLOTS + (0 + ... + binlog_arg_slots(args));
+	uint32_t head = ring->head;
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	if(BINLOG_RING_SLOTS - (head - tail) < slot_count){
+		__atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	struct binlog_record record = {binlog_now_ns(), id, (uint16_t)slot_count, (uint16_t)ring->index, (uint8_t)category, (uint8_t)level};
+	uint64_t header[BINLOG_HEADER_SLOTS];
+	memcpy(header, &record, sizeof(record));
+	uint32_t pos = head;
+	for(uint32_t i = 0;i < BINLOG_HEADER_SLOTS;i++){
+		ring->slots[pos++ & (BINLOG_RING_SLOTS - 1)] = header[i];
+	}
+	((pos = binlog_put(ring->slots, pos, args)), ...);
+	__atomic_store_n(&ring->head, head + slot_count, __ATOMIC_RELEASE);
+}
+
+// writer side, everything below runs on the writer thread, or on whoever calls binlog_flush while it is not running
+static FILE *binlog_file = NULL;
+static pthread_mutex_t binlog_writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t binlog_writer_thread;
+static bool binlog_writer_running = false;
+static bool binlog_writer_stop = false;
+static uint32_t binlog_formats_written = 0;
+// called on the writer thread before each drain when set, the asi keeps the writer off the game core with it
+static void (*binlog_writer_wake)() = NULL;
+static uint32_t binlog_threads_written = 0;
+static uint32_t binlog_dropped_written[BINLOG_MAX_THREADS + 1];
+// a ring's worth, so a drained ring is free again before the disk is touched
+static uint64_t binlog_batch[BINLOG_RING_SLOTS];
+
+static void binlog_emit(uint16_t format, uint16_t thread, const uint64_t *args, uint32_t arg_slots){
+	struct binlog_record record = {binlog_now_ns(), format, (uint16_t)(BINLOG_HEADER_SLOTS + arg_slots), thread, 0, BINLOG_LEVEL_OFF};
+	fwrite(&record, sizeof(record), 1, binlog_file);
+	fwrite(args, 8, arg_slots, binlog_file);
+}
+
+static uint32_t binlog_pack_string(uint64_t *slots, const char *s){
+	size_t len = strlen(s);
+	slots[0] = len;
+	memset(&slots[1], 0, (len + 7) / 8 * 8);
+	memcpy(&slots[1], s, len);
+	return 1 + (len + 7) / 8;
+}
+
+static void binlog_emit_definitions(){
+	uint32_t count = __atomic_load_n(&binlog_format_count, __ATOMIC_ACQUIRE);
+	if(count > BINLOG_MAX_FORMATS - BINLOG_FIRST_FORMAT){
+		count = BINLOG_MAX_FORMATS - BINLOG_FIRST_FORMAT;
+	}
+	while(binlog_formats_written < count){
+		const struct binlog_format *format = &binlog_formats[binlog_formats_written];
+		const char *fmt = __atomic_load_n(&format->fmt, __ATOMIC_ACQUIRE);
+		if(fmt == NULL){
+			break;
+		}
+		static uint64_t args[1 + 1 + BINLOG_MAX_STRING / 8 + 1 + 1 + BINLOG_MAX_FORMAT_LENGTH / 8 + 1];
+		uint32_t len = 0;
+		args[len++] = binlog_formats_written + BINLOG_FIRST_FORMAT;
+		len += binlog_pack_string(&args[len], strlen(format->types) <= BINLOG_MAX_STRING ? format->types : "");
+		len += binlog_pack_string(&args[len], strlen(fmt) <= BINLOG_MAX_FORMAT_LENGTH ? fmt : "(format too long)");
+		binlog_emit(BINLOG_FORMAT_DEFINITION, 0, args, len);
+		binlog_formats_written++;
+	}
+}
+
+// moves everything logged so far to the file, false when there was nothing
+static bool binlog_drain(){
+	bool wrote = false;
+	uint32_t ring_count = __atomic_load_n(&binlog_ring_count, __ATOMIC_RELAXED);
+	if(ring_count > BINLOG_MAX_THREADS){
+		ring_count = BINLOG_MAX_THREADS;
+	}
+	for(uint32_t i = 0;i < ring_count;i++){
+		struct binlog_ring *ring = __atomic_load_n(&binlog_rings[i], __ATOMIC_ACQUIRE);
+		if(ring == NULL){
+			continue;
+		}
+		if(i >= binlog_threads_written){
+			uint64_t args[2] = {i, ring->os_thread_id};
+			binlog_emit(BINLOG_FORMAT_THREAD, i, args, 2);
+			binlog_threads_written = i + 1;
+		}
+
+		uint32_t tail = ring->tail;
+		uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		uint32_t count = head - tail;
+		for(uint32_t j = 0;j < count;j++){
+			binlog_batch[j] = ring->slots[(tail + j) & (BINLOG_RING_SLOTS - 1)];
+		}
+		__atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+
+		// formats are registered before their first record is written, so this covers every record in the batch
+		binlog_emit_definitions();
+		if(count != 0){
+			fwrite(binlog_batch, 8, count, binlog_file);
+			wrote = true;
+		}
+		uint32_t dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+		if(dropped != binlog_dropped_written[i]){
+			uint64_t args[2] = {i, dropped};
+			binlog_emit(BINLOG_FORMAT_DROPPED, i, args, 2);
+			binlog_dropped_written[i] = dropped;
+		}
+	}
+	uint32_t orphan_dropped = __atomic_load_n(&binlog_orphan_dropped, __ATOMIC_RELAXED);
+	if(orphan_dropped != binlog_dropped_written[BINLOG_MAX_THREADS]){
+		uint64_t args[2] = {BINLOG_MAX_THREADS, orphan_dropped};
+		binlog_emit(BINLOG_FORMAT_DROPPED, BINLOG_MAX_THREADS, args, 2);
+		binlog_dropped_written[BINLOG_MAX_THREADS] = orphan_dropped;
+	}
+	return wrote;
+}
+
+// drains the rings once, skipped when the writer is busy or died holding the lock, eg. at process exit
+static void binlog_flush(){
+	if(binlog_file == NULL || pthread_mutex_trylock(&binlog_writer_mutex) != 0){
+		return;
+	}
+	binlog_drain();
+	fflush(binlog_file);
+	pthread_mutex_unlock(&binlog_writer_mutex);
+}
+
+static void *binlog_writer(void *arg){
+	while(!__atomic_load_n(&binlog_writer_stop, __ATOMIC_RELAXED)){
+		if(binlog_writer_wake != NULL){
+			binlog_writer_wake();
+		}
+		pthread_mutex_lock(&binlog_writer_mutex);
+		if(binlog_drain()){
+			fflush(binlog_file);
+		}
+		pthread_mutex_unlock(&binlog_writer_mutex);
+		#ifdef _WIN32
+		Sleep(BINLOG_FLUSH_MS);
+		#else
+		struct timespec delay = {0, BINLOG_FLUSH_MS * 1000 * 1000};
+		nanosleep(&delay, NULL);
+		#endif
+	}
+	binlog_flush();
+	return NULL;
+}
+
+// call once before the first record, now_ns stamps every record
+// records are kept in the rings from here on while enabled, and only reach a file once binlog_start is called
+static bool binlog_init(uint64_t (*now_ns)()){
+	binlog_now_ns = now_ns;
+	#ifdef _WIN32
+	binlog_tls_index = TlsAlloc();
+	if(binlog_tls_index == TLS_OUT_OF_INDEXES){
+		return false;
+	}
+	#endif
+	return true;
+}
+
+// opens the file the first time, then starts the writer thread
+static bool binlog_start(const char *path){
+	if(binlog_writer_running){
+		return true;
+	}
+	if(binlog_file == NULL){
+		binlog_file = fopen(path, "wb");
+		if(binlog_file == NULL){
+			return false;
+		}
+		struct binlog_file_header header = {BINLOG_MAGIC, BINLOG_VERSION, binlog_now_ns(), (int64_t)time(NULL), 0};
+		fwrite(&header, sizeof(header), 1, binlog_file);
+	}
+	binlog_writer_stop = false;
+	if(pthread_create(&binlog_writer_thread, NULL, binlog_writer, NULL) != 0){
+		return false;
+	}
+	binlog_writer_running = true;
+	return true;
+}
+
+// stops and joins the writer after a last drain, the file stays open for binlog_flush
+static void binlog_stop(){
+	if(!binlog_writer_running){
+		return;
+	}
+	__atomic_store_n(&binlog_writer_stop, true, __ATOMIC_RELAXED);
+	pthread_join(binlog_writer_thread, NULL);
+	binlog_writer_running = false;
+}
+
+// reader side, offline only, binlog_decode.cpp and binlog_check.cpp walk files with it
+struct binlog_definition{
+	bool defined;
+	char types[BINLOG_MAX_STRING + 1];
+	char fmt[BINLOG_MAX_FORMAT_LENGTH + 1];
+};
+
+struct binlog_value{
+	char type;
+	uint64_t raw;
+	// strings only, not terminated
+	const char *str;
+	size_t len;
+};
+
+struct binlog_reader{
+	FILE *file;
+	struct binlog_file_header header;
+	// indexed by format id
+	struct binlog_definition *definitions;
+	struct binlog_record record;
+	// arguments of the current record
+	uint64_t *slots;
+	uint32_t slot_count;
+	// bytes read so far, for error messages
+	uint64_t offset;
+};
+
+static bool binlog_reader_open(struct binlog_reader *reader, FILE *file){
+	memset(reader, 0, sizeof(struct binlog_reader));
+	reader->file = file;
+	if(fread(&reader->header, sizeof(reader->header), 1, file) != 1 || reader->header.magic != BINLOG_MAGIC || reader->header.version != BINLOG_VERSION){
+		return false;
+	}
+	reader->offset = sizeof(reader->header);
+	reader->definitions = (struct binlog_definition *)calloc(BINLOG_MAX_FORMATS, sizeof(struct binlog_definition));
+	reader->slots = (uint64_t *)malloc(UINT16_MAX * 8);
+	return reader->definitions != NULL && reader->slots != NULL;
+}
+
+static void binlog_reader_close(struct binlog_reader *reader){
+	free(reader->definitions);
+	free(reader->slots);
+	reader->definitions = NULL;
+	reader->slots = NULL;
+}
+
+// reads a string argument at *pos, false when it runs past the record
+static bool binlog_read_string(const struct binlog_reader *reader, uint32_t *pos, const char **str, size_t *len){
+	if(*pos >= reader->slot_count){
+		return false;
+	}
+	uint64_t length = reader->slots[*pos];
+	uint32_t string_slots = (length + 7) / 8;
+	if(length > BINLOG_MAX_FORMAT_LENGTH || *pos + 1 + string_slots > reader->slot_count){
+		return false;
+	}
+	*str = (const char *)&reader->slots[*pos + 1];
+	*len = length;
+	*pos += 1 + string_slots;
+	return true;
+}
+
+// 1 on a record, 0 at the end of the file, -1 when it is cut or damaged
+// definitions are taken in as well as returned
+static int binlog_reader_next(struct binlog_reader *reader){
+	size_t got = fread(&reader->record, 1, sizeof(reader->record), reader->file);
+	if(got == 0){
+		return 0;
+	}
+	if(got != sizeof(reader->record) || reader->record.slots < BINLOG_HEADER_SLOTS || reader->record.format >= BINLOG_MAX_FORMATS){
+		return -1;
+	}
+	reader->slot_count = reader->record.slots - BINLOG_HEADER_SLOTS;
+	if(fread(reader->slots, 8, reader->slot_count, reader->file) != reader->slot_count){
+		return -1;
+	}
+	reader->offset += reader->record.slots * 8;
+
+	if(reader->record.format == BINLOG_FORMAT_DEFINITION){
+		uint32_t pos = 1;
+		const char *types;
+		const char *fmt;
+		size_t types_len;
+		size_t fmt_len;
+		if(reader->slot_count < 1 || reader->slots[0] >= BINLOG_MAX_FORMATS || reader->slots[0] < BINLOG_FIRST_FORMAT ||
+			!binlog_read_string(reader, &pos, &types, &types_len) || types_len > BINLOG_MAX_STRING ||
+			!binlog_read_string(reader, &pos, &fmt, &fmt_len)){
+			return -1;
+		}
+		struct binlog_definition *definition = &reader->definitions[reader->slots[0]];
+		memcpy(definition->types, types, types_len);
+		definition->types[types_len] = '\0';
+		memcpy(definition->fmt, fmt, fmt_len);
+		definition->fmt[fmt_len] = '\0';
+		definition->defined = true;
+	}
+	return 1;
+}
+
+// the current record's arguments by its definition, returns how many, -1 when they don't match it
+static int binlog_reader_values(const struct binlog_reader *reader, struct binlog_value *values, int max_values){
+	const struct binlog_definition *definition = &reader->definitions[reader->record.format];
+	if(reader->record.format < BINLOG_FIRST_FORMAT || !definition->defined){
+		return -1;
+	}
+	uint32_t pos = 0;
+	int count = 0;
+	for(const char *type = definition->types;*type != '\0' && count < max_values;type++){
+		struct binlog_value *value = &values[count++];
+		value->type = *type;
+		if(*type == BINLOG_ARG_STRING){
+			if(!binlog_read_string(reader, &pos, &value->str, &value->len)){
+				return -1;
+			}
+			value->raw = 0;
+			continue;
+		}
+		if(pos >= reader->slot_count){
+			return -1;
+		}
+		value->raw = reader->slots[pos++];
+	}
+	return count;
+}
+
+// the current record as the text LOG would have written, cut to size
+static void binlog_format_message(const struct binlog_reader *reader, char *out, size_t size){
+	struct binlog_value values[BINLOG_MAX_STRING];
+	int value_count = binlog_reader_values(reader, values, BINLOG_MAX_STRING);
+	if(value_count < 0){
+		snprintf(out, size, "(record with unknown format %u)", reader->record.format);
+		return;
+	}
+	const char *fmt = reader->definitions[reader->record.format].fmt;
+	size_t len = 0;
+	int next_value = 0;
+	#define BINLOG_APPEND(...) \
+	{ \
+		if(len < size){ \
+			int _written = snprintf(out + len, size - len, __VA_ARGS__); \
+			len += _written > 0 ? _written : 0; \
+		} \
+	}
+	for(const char *c = fmt;*c != '\0';c++){
+		if(*c != '%'){
+			if(len + 1 < size){
+				out[len++] = *c;
+				out[len] = '\0';
+			}
+			continue;
+		}
+		if(c[1] == '%'){
+			BINLOG_APPEND("%%");
+			c++;
+			continue;
+		}
+		// flags, width and precision are kept, length modifiers are replaced by what the stored value needs
+		char spec[32] = "%";
+		size_t spec_len = 1;
+		const char *start = c + 1;
+		c = start;
+		while(*c != '\0' && strchr("-+ #0123456789.", *c) != NULL){
+			c++;
+		}
+		if(c - start > (ptrdiff_t)sizeof(spec) - 4){
+			c = start + sizeof(spec) - 4;
+		}
+		memcpy(spec + spec_len, start, c - start);
+		spec_len += c - start;
+		while(*c != '\0' && strchr("hlLqjzt", *c) != NULL){
+			c++;
+		}
+		char conversion = *c;
+		if(conversion == '\0'){
+			break;
+		}
+		if(next_value >= value_count){
+			BINLOG_APPEND("(missing)");
+			continue;
+		}
+		const struct binlog_value *value = &values[next_value++];
+		double d;
+		memcpy(&d, &value->raw, sizeof(double));
+		if(value->type == BINLOG_ARG_STRING){
+			char str[BINLOG_MAX_FORMAT_LENGTH + 1];
+			memcpy(str, value->str, value->len);
+			str[value->len] = '\0';
+			spec[spec_len++] = 's';
+			spec[spec_len] = '\0';
+			BINLOG_APPEND(spec, str);
+		}else if(strchr("fFeEgGaA", conversion) != NULL){
+			spec[spec_len++] = conversion;
+			spec[spec_len] = '\0';
+			BINLOG_APPEND(spec, value->type == BINLOG_ARG_DOUBLE ? d : value->type == BINLOG_ARG_INT ? (double)(int64_t)value->raw : (double)value->raw);
+		}else if(conversion == 'c'){
+			spec[spec_len++] = 'c';
+			spec[spec_len] = '\0';
+			BINLOG_APPEND(spec, (int)value->raw);
+		}else if(conversion == 'p'){
+			BINLOG_APPEND("0x%llx", (unsigned long long)value->raw);
+		}else{
+			bool is_signed = conversion == 'd' || conversion == 'i';
+			if(strchr("diuoxX", conversion) == NULL){
+				conversion = value->type == BINLOG_ARG_INT ? 'd' : 'u';
+				is_signed = conversion == 'd';
+			}
+			spec[spec_len++] = 'l';
+			spec[spec_len++] = 'l';
+			spec[spec_len++] = conversion;
+			spec[spec_len] = '\0';
+			long long integer = value->type == BINLOG_ARG_DOUBLE ? (long long)d : (long long)value->raw;
+			if(is_signed){
+				BINLOG_APPEND(spec, integer);
+			}else{
+				// 32 bit values print as the game would have, eg. pointers passed to %08x
+				unsigned long long unsigned_integer = value->type == BINLOG_ARG_INT && integer < 0 ? (unsigned long long)(uint32_t)integer : (unsigned long long)integer;
+				BINLOG_APPEND(spec, unsigned_integer);
+			}
+		}
+	}
+	#undef BINLOG_APPEND
+	if(len == 0 && size > 0){
+		out[0] = '\0';
+	}
+}
+
+#endif // BINLOG_H
@@ -0,0 +1,379 @@
+// checks the binary logger in binlog.h on the linux build host and times a record against the text logger it replaced
+// records go through the rings, the writer thread and a file, then back through the reader and are compared with snprintf
+// build with build_tools.sh, run with --help for options
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "binlog.h"
+
+// as in the asi, with the category given at each call instead of per part of the file
+#define LOG_AT(category, level, ...) \
+{ \
+	if(__builtin_expect(binlog_on(BINLOG_BIT(category, level)), 0)){ \
+		static uint16_t _binlog_format = 0; \
+		binlog_write(&_binlog_format, category, level, __VA_ARGS__); \
+	} \
+}
+#define LOG(...) LOG_AT(BINLOG_CATEGORY_HOOKS, BINLOG_LEVEL_INFO, __VA_ARGS__)
+
+static void set_levels(int level){
+	int levels[BINLOG_CATEGORY_COUNT];
+	for(int i = 0;i < BINLOG_CATEGORY_COUNT;i++){
+		levels[i] = level;
+	}
+	binlog_set_mask(binlog_mask_for(levels));
+}
+
+static int checks = 0;
+static int failed = 0;
+
+static void check(bool ok, const char *what){
+	checks++;
+	if(!ok){
+		failed++;
+		printf("  failed: %s\n", what);
+	}
+}
+
+static uint64_t now_ns(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+// what each record should read as, in the order one thread wrote them
+#define EXPECTED_MAX 64
+static char expected[EXPECTED_MAX][512];
+static int expected_count = 0;
+
+#define LOG_EXPECT(...) \
+{ \
+	LOG(__VA_ARGS__); \
+	snprintf(expected[expected_count++], sizeof(expected[0]), __VA_ARGS__); \
+}
+
+enum check_enum{
+	CHECK_ENUM_A = -2,
+};
+
+static void write_check_records(){
+	char stack_string[] = "on the stack";
+	const char *null_string = NULL;
+	int negative = -5;
+	uint32_t address = 0x00871970;
+	float f = 0.015f;
+	LOG_EXPECT("no arguments");
+	LOG_EXPECT("ints %d %u %lu %llu %x %08x", negative, 7u, (unsigned long)42, 1ull << 40, 255, address);
+	LOG_EXPECT("doubles %f %.3f %e %g", 1.5, 3.14159, 1e-9, (double)f);
+	LOG_EXPECT("strings %s, %s, %-8s|", "literal", stack_string, "left");
+	LOG_EXPECT("%s: %d%% done, enum %d, bool %d, char %c", __FUNCTION__, 50, CHECK_ENUM_A, true, 'x');
+	LOG_EXPECT("%04d-%02d-%02d %02d:%02d:%02d.%03d", 2026, 10, 17, 9, 5, 3, 7);
+	LOG_EXPECT("long string %s", "0123456789012345678901234567890123456789012345678901234567890123456789");
+	LOG("null string %s", null_string);
+	snprintf(expected[expected_count++], sizeof(expected[0]), "null string (null)");
+}
+
+// per category counts of what read_back saw
+static int category_records[BINLOG_CATEGORY_COUNT][BINLOG_LEVEL_COUNT];
+
+static bool read_back(const char *path, int *records, int *mismatches, uint64_t *dropped){
+	memset(category_records, 0, sizeof(category_records));
+	FILE *file = fopen(path, "rb");
+	if(file == NULL){
+		return false;
+	}
+	struct binlog_reader reader;
+	if(!binlog_reader_open(&reader, file)){
+		fclose(file);
+		return false;
+	}
+	int result;
+	char message[1024];
+	while((result = binlog_reader_next(&reader)) == 1){
+		if(reader.record.format == BINLOG_FORMAT_DROPPED){
+			*dropped = reader.slots[1];
+		}
+		if(reader.record.format < BINLOG_FIRST_FORMAT){
+			continue;
+		}
+		if(reader.record.category < BINLOG_CATEGORY_COUNT && reader.record.level < BINLOG_LEVEL_COUNT){
+			category_records[reader.record.category][reader.record.level]++;
+		}
+		binlog_format_message(&reader, message, sizeof(message));
+		if(*records < expected_count && strcmp(message, expected[*records]) != 0){
+			printf("  record %d reads \"%s\", expected \"%s\"\n", *records, message, expected[*records]);
+			(*mismatches)++;
+		}
+		(*records)++;
+	}
+	binlog_reader_close(&reader);
+	fclose(file);
+	return result == 0;
+}
+
+static void check_round_trip(const char *path){
+	set_levels(BINLOG_LEVEL_INFO);
+	write_check_records();
+	// nothing reaches a file before binlog_start, the records wait in the ring
+	check(binlog_start(path), "writer starts");
+	binlog_stop();
+	set_levels(BINLOG_LEVEL_OFF);
+	fflush(binlog_file);
+
+	int records = 0;
+	int mismatches = 0;
+	uint64_t dropped = 0;
+	check(read_back(path, &records, &mismatches, &dropped), "the file reads back to the end");
+	check(records == expected_count, "every record reads back");
+	check(mismatches == 0, "records read the same as snprintf");
+}
+
+static uint64_t *fill_counter;
+
+// a thread of its own, so its ring starts empty and nothing drains it
+static void *fill_ring(void *arg){
+	set_levels(BINLOG_LEVEL_INFO);
+	for(int i = 0;i < BINLOG_RING_SLOTS;i++){
+		LOG("filling %d", i);
+	}
+	*fill_counter = binlog_ring()->dropped;
+	return NULL;
+}
+
+static void check_full_ring(const char *path){
+	uint64_t dropped_in_thread = 0;
+	fill_counter = &dropped_in_thread;
+	pthread_t thread;
+	pthread_create(&thread, NULL, fill_ring, NULL);
+	pthread_join(thread, NULL);
+	set_levels(BINLOG_LEVEL_OFF);
+	// each record is 3 slots, so a third of them fit
+	check(dropped_in_thread == BINLOG_RING_SLOTS - BINLOG_RING_SLOTS / 3, "a full ring drops records instead of blocking");
+	binlog_flush();
+
+	expected_count = 0;
+	int records = 0;
+	int mismatches = 0;
+	uint64_t dropped = 0;
+	read_back(path, &records, &mismatches, &dropped);
+	check(dropped == dropped_in_thread, "dropped records are reported in the file");
+}
+
+// stand ins for a movement hook and the fov hook, the first also without its log calls
+struct mock_actor{
+	float x;
+	float y;
+	float z;
+	uint32_t state;
+};
+
+__attribute__((noinline)) static void mock_move_plain(struct mock_actor *actor, float x, float y, float z){
+	float modifier = actor->state == 7 ? 0.5f : 1.0f;
+	actor->x += x * modifier;
+	actor->y += y * modifier;
+	actor->z += z * modifier;
+	actor->state = (actor->state + 1) & 15;
+}
+
+__attribute__((noinline)) static void mock_move_logged(struct mock_actor *actor, float x, float y, float z){
+	LOG_AT(BINLOG_CATEGORY_MOVEMENT, BINLOG_LEVEL_VERBOSE, "%s: ctx 0x%08x, param_1 %f, param_2 %f, param_3 %f", __FUNCTION__, actor, x, y, z);
+	LOG_AT(BINLOG_CATEGORY_MOVEMENT, BINLOG_LEVEL_VERBOSE, "%s: actx->actor_state %u", __FUNCTION__, actor->state);
+	float modifier = actor->state == 7 ? 0.5f : 1.0f;
+	if(actor->state == 7){
+		LOG_AT(BINLOG_CATEGORY_MOVEMENT, BINLOG_LEVEL_VERBOSE, "%s: applying fly speed fix, y %f, y/param_2 %f", __FUNCTION__, y, modifier);
+	}
+	actor->x += x * modifier;
+	actor->y += y * modifier;
+	actor->z += z * modifier;
+	actor->state = (actor->state + 1) & 15;
+	LOG_AT(BINLOG_CATEGORY_MOVEMENT, BINLOG_LEVEL_VERBOSE, "%s: %f %f %f", __FUNCTION__, actor->x, actor->y, actor->z);
+}
+
+__attribute__((noinline)) static void mock_fov_logged(float *fov, float target){
+	*fov = target;
+	LOG_AT(BINLOG_CATEGORY_FOV, BINLOG_LEVEL_VERBOSE, "%s: current fov %f, override fov %f", __FUNCTION__, *fov, target);
+}
+
+// a category at verbose doesn't let another one's verbose records through
+static void check_categories(const char *path){
+	int levels[BINLOG_CATEGORY_COUNT];
+	for(int i = 0;i < BINLOG_CATEGORY_COUNT;i++){
+		levels[i] = BINLOG_LEVEL_INFO;
+	}
+	levels[BINLOG_CATEGORY_FOV] = BINLOG_LEVEL_VERBOSE;
+	levels[BINLOG_CATEGORY_SPREAD] = BINLOG_LEVEL_OFF;
+	binlog_set_mask(binlog_mask_for(levels));
+	struct mock_actor actor = {};
+	float fov = 0;
+	for(int i = 0;i < 16;i++){
+		mock_move_logged(&actor, 1, 2, 3);
+		mock_fov_logged(&fov, 90);
+		LOG_AT(BINLOG_CATEGORY_SPREAD, BINLOG_LEVEL_INFO, "spread %d", i);
+		LOG_AT(BINLOG_CATEGORY_MOVEMENT, BINLOG_LEVEL_INFO, "movement %d", i);
+	}
+	set_levels(BINLOG_LEVEL_OFF);
+	binlog_flush();
+
+	expected_count = 0;
+	int records = 0;
+	int mismatches = 0;
+	uint64_t dropped = 0;
+	read_back(path, &records, &mismatches, &dropped);
+	check(category_records[BINLOG_CATEGORY_FOV][BINLOG_LEVEL_VERBOSE] == 16, "verbose records of a verbose category are kept");
+	check(category_records[BINLOG_CATEGORY_MOVEMENT][BINLOG_LEVEL_VERBOSE] == 0, "verbose records of an info category are skipped");
+	check(category_records[BINLOG_CATEGORY_MOVEMENT][BINLOG_LEVEL_INFO] == 16, "info records of an info category are kept");
+	check(category_records[BINLOG_CATEGORY_SPREAD][BINLOG_LEVEL_INFO] == 0, "a category that is off records nothing");
+}
+
+// best of several rounds, so a preempted round doesn't count
+static double time_mock_move(void (*move)(struct mock_actor *, float, float, float), int iterations){
+	double best_ns = 0;
+	for(int round = 0;round < 5;round++){
+		struct mock_actor actor = {};
+		uint64_t start_ns = now_ns();
+		for(int i = 0;i < iterations;i++){
+			move(&actor, 1, i, 3);
+		}
+		double ns = (double)(now_ns() - start_ns) / iterations;
+		if(round == 0 || ns < best_ns){
+			best_ns = ns;
+		}
+	}
+	return best_ns;
+}
+
+static void bench_disabled_hook(int iterations){
+	// another category at verbose, as when debugging the fov hook
+	int levels[BINLOG_CATEGORY_COUNT];
+	for(int i = 0;i < BINLOG_CATEGORY_COUNT;i++){
+		levels[i] = BINLOG_LEVEL_INFO;
+	}
+	levels[BINLOG_CATEGORY_FOV] = BINLOG_LEVEL_VERBOSE;
+	binlog_set_mask(binlog_mask_for(levels));
+	double plain_ns = time_mock_move(mock_move_plain, iterations * 10);
+	double logged_ns = time_mock_move(mock_move_logged, iterations * 10);
+	set_levels(BINLOG_LEVEL_OFF);
+	printf("%-32s %8.2f ns/call\n", "hook without log calls", plain_ns);
+	printf("%-32s %8.2f ns/call\n", "hook with 4 disabled log calls", logged_ns);
+}
+
+// what LOG did before, with logging compiled in
+static FILE *text_log = NULL;
+static char text_log_buf[500];
+static pthread_mutex_t text_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define TEXT_LOG(...) \
+{ \
+	pthread_mutex_lock(&text_log_mutex); \
+	snprintf(text_log_buf, sizeof(text_log_buf), __VA_ARGS__); \
+	size_t _len = strlen(text_log_buf); \
+	if(_len + 1 < sizeof(text_log_buf)){ \
+		text_log_buf[_len] = '\n'; \
+		text_log_buf[_len + 1] = '\0'; \
+	} \
+	fprintf(text_log, "%s", text_log_buf); \
+	fflush(text_log); \
+	pthread_mutex_unlock(&text_log_mutex); \
+}
+
+#define BENCH(label, ...) \
+{ \
+	uint64_t start_ns = now_ns(); \
+	for(int i = 0;i < iterations;i++){ \
+		__VA_ARGS__; \
+	} \
+	printf("%-32s %8.1f ns/record\n", label, (double)(now_ns() - start_ns) / iterations); \
+}
+
+static void bench(const char *path, int iterations){
+	// the writer keeps up at 50 ms flushes only if the burst fits a ring, so this runs in bursts with pauses between
+	check(binlog_start(path), "writer starts");
+	set_levels(BINLOG_LEVEL_OFF);
+	BENCH("disabled", LOG("frametime %f, state %d", 6.944, i));
+	// part of every record, slow on some virtual machines
+	uint64_t sum = 0;
+	BENCH("timestamp alone", sum += binlog_now_ns());
+	check(sum != 0, "the clock moves");
+	set_levels(BINLOG_LEVEL_INFO);
+	uint64_t dropped_before = binlog_ring()->dropped;
+	int burst = iterations;
+	iterations = 1000;
+	BENCH("no arguments", LOG("tick"));
+	usleep(100 * 1000);
+	BENCH("a double and an int", LOG("frametime %f, state %d", 6.944, i));
+	usleep(100 * 1000);
+	BENCH("four ints", LOG("%d %d %d %d", i, i + 1, i + 2, i + 3));
+	usleep(100 * 1000);
+	BENCH("a short string", LOG("game state %s", "match"));
+	usleep(100 * 1000);
+	uint64_t dropped = binlog_ring()->dropped - dropped_before;
+	set_levels(BINLOG_LEVEL_OFF);
+	binlog_stop();
+
+	iterations = burst;
+	bench_disabled_hook(iterations);
+	text_log = fopen("/dev/null", "w");
+	BENCH("text logger, a double and an int", TEXT_LOG("frametime %f, state %d", 6.944, i));
+	fclose(text_log);
+	printf("%llu records dropped while timing\n", (unsigned long long)dropped);
+}
+
+static void usage(const char *argv0){
+	printf("usage: %s [options]\n", argv0);
+	printf("  --file FILE          where the writer puts the log, default binlog_check.binlog, removed afterwards\n");
+	printf("  --iterations N       records per timing of the text logger, default 100000\n");
+	printf("  --check              only check, skip the timing\n");
+}
+
+// the asi stamps records with the tsc, this is the closest to it
+static uint64_t check_clock_ns(){
+	return __builtin_ia32_rdtsc();
+}
+
+int main(int argc, char **argv){
+	const char *path = "binlog_check.binlog";
+	int iterations = 100000;
+	bool check_only = false;
+	for(int i = 1;i < argc;i++){
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+		if(strcmp(arg, "--check") == 0){
+			check_only = true;
+			continue;
+		}
+		if(strcmp(arg, "--help") == 0){
+			usage(argv[0]);
+			return 0;
+		}
+		if(value == NULL){
+			fprintf(stderr, "%s needs a value\n", arg);
+			return 1;
+		}
+		if(strcmp(arg, "--file") == 0){
+			path = value;
+		}else if(strcmp(arg, "--iterations") == 0){
+			iterations = atoi(value);
+		}else{
+			fprintf(stderr, "unknown option %s\n", arg);
+			usage(argv[0]);
+			return 1;
+		}
+		i++;
+	}
+
+	binlog_init(check_clock_ns);
+	check_round_trip(path);
+	check_full_ring(path);
+	check_categories(path);
+	if(!check_only){
+		bench(path, iterations);
+	}
+	remove(path);
+	printf("%d of %d checks passed\n", checks - failed, checks);
+	return failed != 0;
+}
@@ -0,0 +1,758 @@
+// turns the asi's binary log, s4_league_fps_unlock.binlog, back into text, csv or json lines on the linux build host
+// and sums it up per hook and per frame, the file is read front to back in fixed memory however large the capture is
+// build with build_tools.sh, run with --help for options
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <pthread.h>
+
+#include "binlog.h"
+
+// the verbose record patched_game_tick writes first each frame, under the limiter category, log_limiter has to be verbose for frames to show up
+#define FRAME_MARKER "game tick function hook fired"
+
+// frametimes are binned by 10us up to 100ms, longer ones land in the last bin
+#define FRAMETIME_BIN_NS 10000
+#define FRAMETIME_BINS 10000
+// calls of a hook in one frame are binned one by one up to this many
+#define CALL_BINS 256
+// a hook is a function logging its name first, "%s: ...", as the hooks in the asi do with __FUNCTION__
+#define MAX_HOOKS 256
+#define MAX_HOOK_NAME 64
+
+#define ALL_CATEGORIES ((1u << BINLOG_CATEGORY_COUNT) - 1)
+
+enum output_format{
+	OUTPUT_TEXT = 0,
+	OUTPUT_CSV,
+	OUTPUT_JSON,
+	OUTPUT_COUNT
+};
+static const char *output_format_names[OUTPUT_COUNT] = {
+	"text",
+	"csv",
+	"json",
+};
+
+struct filter{
+	// a bit per category
+	uint32_t categories;
+	// seconds from the start of the file, as printed
+	double from_s;
+	double to_s;
+	// part of a hook's name, NULL for every record
+	const char *hook;
+};
+
+enum format_kind{
+	FORMAT_UNSEEN = 0,
+	FORMAT_PLAIN,
+	FORMAT_HOOK,
+	FORMAT_FRAME,
+};
+
+struct hook_stats{
+	char name[MAX_HOOK_NAME];
+	uint64_t records;
+	// a call is counted by the hook's most frequent record in a frame, some of its records are conditional
+	uint64_t frame_calls;
+	uint64_t framed_calls;
+	uint64_t frames_called;
+	uint64_t max_frame_calls;
+	uint64_t call_bins[CALL_BINS + 1];
+};
+
+// everything the summary needs, sized up front so memory doesn't grow with the file
+struct analysis{
+	uint64_t records;
+	uint64_t printed;
+	uint64_t category_records[BINLOG_CATEGORY_COUNT][BINLOG_LEVEL_COUNT];
+	// the running count each thread last reported
+	uint64_t dropped[BINLOG_MAX_THREADS + 1];
+
+	uint8_t format_kind[BINLOG_MAX_FORMATS];
+	int16_t format_hook[BINLOG_MAX_FORMATS];
+	// records of each format in the frame in progress, and the formats that have any
+	uint32_t format_frame_records[BINLOG_MAX_FORMATS];
+	uint16_t touched[BINLOG_MAX_FORMATS];
+	uint32_t touched_count;
+	struct hook_stats hooks[MAX_HOOKS];
+	uint32_t hook_count;
+
+	// frames are counted on the thread writing the frame marker, records of other threads don't count into them
+	bool in_frame;
+	uint16_t frame_thread;
+	uint64_t frame_start_ns;
+	uint64_t frames;
+	uint64_t frametime_min_ns;
+	uint64_t frametime_max_ns;
+	double frametime_sum_ms;
+	double frametime_square_sum_ms;
+	uint64_t frametime_bins[FRAMETIME_BINS + 1];
+};
+
+static void write_csv_field(FILE *out, const char *s, size_t len){
+	fputc('"', out);
+	for(size_t i = 0;i < len;i++){
+		if(s[i] == '"'){
+			fputc('"', out);
+		}
+		fputc(s[i], out);
+	}
+	fputc('"', out);
+}
+
+static void write_json_string(FILE *out, const char *s, size_t len){
+	fputc('"', out);
+	for(size_t i = 0;i < len;i++){
+		unsigned char c = s[i];
+		if(c == '"' || c == '\\'){
+			fputc('\\', out);
+			fputc(c, out);
+		}else if(c == '\n'){
+			fputs("\\n", out);
+		}else if(c < 0x20){
+			fprintf(out, "\\u%04x", c);
+		}else{
+			fputc(c, out);
+		}
+	}
+	fputc('"', out);
+}
+
+static void write_json_values(FILE *out, const struct binlog_value *values, int value_count){
+	fputc('[', out);
+	for(int i = 0;i < value_count;i++){
+		const struct binlog_value *value = &values[i];
+		if(i != 0){
+			fputc(',', out);
+		}
+		double d;
+		memcpy(&d, &value->raw, sizeof(double));
+		switch(value->type){
+			case BINLOG_ARG_INT:
+				fprintf(out, "%lld", (long long)value->raw);
+				break;
+			case BINLOG_ARG_UINT:
+				fprintf(out, "%llu", (unsigned long long)value->raw);
+				break;
+			case BINLOG_ARG_DOUBLE:
+				if(std::isfinite(d)){
+					fprintf(out, "%.17g", d);
+				}else{
+					fputs("null", out);
+				}
+				break;
+			case BINLOG_ARG_POINTER:
+				fprintf(out, "\"0x%08llx\"", (unsigned long long)value->raw);
+				break;
+			case BINLOG_ARG_STRING:
+				write_json_string(out, value->str, value->len);
+				break;
+			default:
+				fputs("null", out);
+				break;
+		}
+	}
+	fputc(']', out);
+}
+
+// one record in the chosen format, the hook is NULL for records that aren't a hook's
+static void write_record(FILE *out, enum output_format format, double seconds, const struct binlog_record *record, const char *hook, const char *message,
+	const struct binlog_value *values, int value_count){
+	const char *category = record->format < BINLOG_FIRST_FORMAT ? "binlog" : record->category < BINLOG_CATEGORY_COUNT ? binlog_category_names[record->category] : "?";
+	const char *level = record->format < BINLOG_FIRST_FORMAT ? "" : record->level < BINLOG_LEVEL_COUNT ? binlog_level_names[record->level] : "?";
+	switch(format){
+		case OUTPUT_TEXT:
+			fprintf(out, "%12.6f [%u] %s: %s\n", seconds, record->thread, category, message);
+			break;
+		case OUTPUT_CSV:
+			fprintf(out, "%.6f,%u,%s,%s,", seconds, record->thread, category, level);
+			if(hook != NULL){
+				write_csv_field(out, hook, strlen(hook));
+			}
+			fputc(',', out);
+			write_csv_field(out, message, strlen(message));
+			fputc('\n', out);
+			break;
+		case OUTPUT_JSON:
+			fprintf(out, "{\"seconds\":%.6f,\"thread\":%u,\"category\":\"%s\",\"level\":\"%s\",\"hook\":", seconds, record->thread, category, level);
+			if(hook != NULL){
+				write_json_string(out, hook, strlen(hook));
+			}else{
+				fputs("null", out);
+			}
+			fputs(",\"message\":", out);
+			write_json_string(out, message, strlen(message));
+			fputs(",\"args\":", out);
+			write_json_values(out, values, value_count);
+			fputs("}\n", out);
+			break;
+		default:
+			break;
+	}
+}
+
+// looks at a format the first time one of its records comes by
+static void classify_format(struct analysis *analysis, const struct binlog_reader *reader, const struct binlog_value *values, int value_count){
+	uint16_t format = reader->record.format;
+	const char *fmt = reader->definitions[format].fmt;
+	analysis->format_kind[format] = FORMAT_PLAIN;
+	analysis->format_hook[format] = -1;
+	if(strcmp(fmt, FRAME_MARKER) == 0){
+		analysis->format_kind[format] = FORMAT_FRAME;
+		return;
+	}
+	if(strncmp(fmt, "%s:", 3) != 0 || value_count < 1 || values[0].type != BINLOG_ARG_STRING){
+		return;
+	}
+	char name[MAX_HOOK_NAME];
+	size_t len = values[0].len < sizeof(name) - 1 ? values[0].len : sizeof(name) - 1;
+	memcpy(name, values[0].str, len);
+	name[len] = '\0';
+	uint32_t hook = 0;
+	while(hook < analysis->hook_count && strcmp(analysis->hooks[hook].name, name) != 0){
+		hook++;
+	}
+	if(hook == analysis->hook_count){
+		if(hook == MAX_HOOKS){
+			return;
+		}
+		memcpy(analysis->hooks[hook].name, name, len + 1);
+		analysis->hook_count++;
+	}
+	analysis->format_kind[format] = FORMAT_HOOK;
+	analysis->format_hook[format] = hook;
+}
+
+static void end_frame(struct analysis *analysis, uint64_t timestamp_ns, uint16_t thread){
+	if(analysis->in_frame && timestamp_ns >= analysis->frame_start_ns){
+		uint64_t frametime_ns = timestamp_ns - analysis->frame_start_ns;
+		double frametime_ms = frametime_ns / 1000000.0;
+		if(analysis->frames == 0 || frametime_ns < analysis->frametime_min_ns){
+			analysis->frametime_min_ns = frametime_ns;
+		}
+		if(frametime_ns > analysis->frametime_max_ns){
+			analysis->frametime_max_ns = frametime_ns;
+		}
+		analysis->frametime_sum_ms += frametime_ms;
+		analysis->frametime_square_sum_ms += frametime_ms * frametime_ms;
+		uint64_t bin = frametime_ns / FRAMETIME_BIN_NS;
+		analysis->frametime_bins[bin < FRAMETIME_BINS ? bin : FRAMETIME_BINS]++;
+		analysis->frames++;
+
+		for(uint32_t i = 0;i < analysis->touched_count;i++){
+			uint16_t format = analysis->touched[i];
+			if(analysis->format_kind[format] != FORMAT_HOOK){
+				continue;
+			}
+			struct hook_stats *hook = &analysis->hooks[analysis->format_hook[format]];
+			if(analysis->format_frame_records[format] > hook->frame_calls){
+				hook->frame_calls = analysis->format_frame_records[format];
+			}
+		}
+		// frames without calls are binned when the summary is written, hooks seen late would miss earlier ones
+		for(uint32_t i = 0;i < analysis->touched_count;i++){
+			uint16_t format = analysis->touched[i];
+			if(analysis->format_kind[format] != FORMAT_HOOK){
+				continue;
+			}
+			struct hook_stats *hook = &analysis->hooks[analysis->format_hook[format]];
+			if(hook->frame_calls == 0){
+				continue;
+			}
+			hook->framed_calls += hook->frame_calls;
+			hook->frames_called++;
+			hook->call_bins[hook->frame_calls < CALL_BINS ? hook->frame_calls : CALL_BINS]++;
+			if(hook->frame_calls > hook->max_frame_calls){
+				hook->max_frame_calls = hook->frame_calls;
+			}
+			hook->frame_calls = 0;
+		}
+	}
+	for(uint32_t i = 0;i < analysis->touched_count;i++){
+		analysis->format_frame_records[analysis->touched[i]] = 0;
+	}
+	analysis->touched_count = 0;
+	analysis->in_frame = true;
+	analysis->frame_start_ns = timestamp_ns;
+	analysis->frame_thread = thread;
+}
+
+// streams the file through the filter, writes what passes to out unless it's NULL, and sums it up into analysis
+// false when the file can't be read to its end, what was read before that is kept
+static bool decode(FILE *file, const char *path, const struct filter *filter, enum output_format format, FILE *out, struct analysis *analysis){
+	struct binlog_reader reader;
+	if(!binlog_reader_open(&reader, file)){
+		fprintf(stderr, "%s is not a version %d binary log\n", path, BINLOG_VERSION);
+		binlog_reader_close(&reader);
+		return false;
+	}
+	if(out != NULL && format == OUTPUT_CSV){
+		fprintf(out, "seconds,thread,category,level,hook,message\n");
+	}
+
+	// timestamps are relative to the file's start, startup records kept from before it come out negative
+	uint64_t start_ns = reader.header.clock_ns;
+	int result;
+	static char message[BINLOG_MAX_FORMAT_LENGTH * 4];
+	static struct binlog_value values[BINLOG_MAX_STRING];
+	while((result = binlog_reader_next(&reader)) == 1){
+		const struct binlog_record *record = &reader.record;
+		if(record->format == BINLOG_FORMAT_DEFINITION){
+			continue;
+		}
+		double seconds = ((int64_t)(record->timestamp_ns - start_ns)) / 1e9;
+		if(seconds < filter->from_s || seconds > filter->to_s){
+			continue;
+		}
+
+		if(record->format < BINLOG_FIRST_FORMAT){
+			uint64_t value = reader.slot_count >= 2 ? reader.slots[1] : 0;
+			if(record->format == BINLOG_FORMAT_DROPPED && record->thread <= BINLOG_MAX_THREADS){
+				analysis->dropped[record->thread] = value;
+			}
+			if(out == NULL || filter->categories != ALL_CATEGORIES || filter->hook != NULL){
+				continue;
+			}
+			if(record->format == BINLOG_FORMAT_THREAD){
+				snprintf(message, sizeof(message), "thread %llu started logging", (unsigned long long)value);
+			}else if(record->format == BINLOG_FORMAT_DROPPED){
+				snprintf(message, sizeof(message), "%llu records dropped so far, the ring was full", (unsigned long long)value);
+			}else{
+				continue;
+			}
+			write_record(out, format, seconds, record, NULL, message, values, 0);
+			analysis->printed++;
+			continue;
+		}
+
+		// arguments are only unpacked when something needs them
+		int value_count = -1;
+		if(analysis->format_kind[record->format] == FORMAT_UNSEEN){
+			value_count = binlog_reader_values(&reader, values, BINLOG_MAX_STRING);
+			classify_format(analysis, &reader, values, value_count);
+		}
+		uint8_t kind = analysis->format_kind[record->format];
+		const char *hook = kind == FORMAT_HOOK ? analysis->hooks[analysis->format_hook[record->format]].name : NULL;
+
+		// frames are counted whatever the filter lets through
+		if(kind == FORMAT_FRAME && (!analysis->in_frame || record->thread == analysis->frame_thread)){
+			end_frame(analysis, record->timestamp_ns, record->thread);
+		}
+
+		bool category_selected = record->category < BINLOG_CATEGORY_COUNT ? (filter->categories >> record->category) & 1 : filter->categories == ALL_CATEGORIES;
+		if(!category_selected || (filter->hook != NULL && (hook == NULL || strstr(hook, filter->hook) == NULL))){
+			continue;
+		}
+		analysis->records++;
+		if(record->category < BINLOG_CATEGORY_COUNT && record->level < BINLOG_LEVEL_COUNT){
+			analysis->category_records[record->category][record->level]++;
+		}
+		if(kind == FORMAT_HOOK){
+			analysis->hooks[analysis->format_hook[record->format]].records++;
+			if(analysis->in_frame && record->thread == analysis->frame_thread){
+				if(analysis->format_frame_records[record->format]++ == 0){
+					analysis->touched[analysis->touched_count++] = record->format;
+				}
+			}
+		}
+
+		if(out == NULL){
+			continue;
+		}
+		if(value_count < 0 && format == OUTPUT_JSON){
+			value_count = binlog_reader_values(&reader, values, BINLOG_MAX_STRING);
+		}
+		binlog_format_message(&reader, message, sizeof(message));
+		write_record(out, format, seconds, record, hook, message, values, value_count > 0 ? value_count : 0);
+		analysis->printed++;
+	}
+	if(result < 0){
+		fprintf(stderr, "%s is cut or damaged after byte %llu\n", path, (unsigned long long)reader.offset);
+	}
+	binlog_reader_close(&reader);
+	return result == 0;
+}
+
+// the bin the p-th fraction of count falls in
+static uint32_t bin_percentile(const uint64_t *bins, uint32_t bin_count, uint64_t count, double p){
+	uint64_t rank = count * p;
+	if(rank >= count){
+		rank = count - 1;
+	}
+	uint64_t seen = 0;
+	for(uint32_t i = 0;i < bin_count;i++){
+		seen += bins[i];
+		if(seen > rank){
+			return i;
+		}
+	}
+	return bin_count - 1;
+}
+
+static double frametime_percentile_ms(const struct analysis *analysis, double p){
+	uint32_t bin = bin_percentile(analysis->frametime_bins, FRAMETIME_BINS + 1, analysis->frames, p);
+	if(bin == FRAMETIME_BINS){
+		return analysis->frametime_max_ns / 1000000.0;
+	}
+	return (bin + 0.5) * FRAMETIME_BIN_NS / 1000000.0;
+}
+
+static const double summary_percentiles[] = {0.5, 0.9, 0.99, 0.999};
+static const char *summary_percentile_names[] = {"p50", "p90", "p99", "p99.9"};
+#define SUMMARY_PERCENTILES (sizeof(summary_percentiles) / sizeof(summary_percentiles[0]))
+
+static void write_summary(FILE *out, enum output_format format, struct analysis *analysis){
+	uint64_t dropped = 0;
+	for(int i = 0;i <= BINLOG_MAX_THREADS;i++){
+		dropped += analysis->dropped[i];
+	}
+	for(uint32_t i = 0;i < analysis->hook_count;i++){
+		struct hook_stats *hook = &analysis->hooks[i];
+		hook->call_bins[0] = analysis->frames - hook->frames_called;
+	}
+	double mean_ms = 0;
+	double stddev_ms = 0;
+	if(analysis->frames != 0){
+		mean_ms = analysis->frametime_sum_ms / analysis->frames;
+		double variance = analysis->frametime_square_sum_ms / analysis->frames - mean_ms * mean_ms;
+		stddev_ms = variance > 0 ? sqrt(variance) : 0;
+	}
+
+	if(format == OUTPUT_JSON){
+		fprintf(out, "{\"records\":%llu,\"dropped\":%llu,\"frames\":%llu", (unsigned long long)analysis->records, (unsigned long long)dropped, (unsigned long long)analysis->frames);
+		if(analysis->frames != 0){
+			fprintf(out, ",\"frametime_ms\":{\"mean\":%.4f,\"stddev\":%.4f,\"min\":%.4f", mean_ms, stddev_ms, analysis->frametime_min_ns / 1000000.0);
+			for(size_t i = 0;i < SUMMARY_PERCENTILES;i++){
+				fprintf(out, ",\"%s\":%.4f", summary_percentile_names[i], frametime_percentile_ms(analysis, summary_percentiles[i]));
+			}
+			fprintf(out, ",\"max\":%.4f}", analysis->frametime_max_ns / 1000000.0);
+		}
+		fprintf(out, ",\"hooks\":[");
+		for(uint32_t i = 0;i < analysis->hook_count;i++){
+			const struct hook_stats *hook = &analysis->hooks[i];
+			fprintf(out, "%s{\"name\":", i == 0 ? "" : ",");
+			write_json_string(out, hook->name, strlen(hook->name));
+			fprintf(out, ",\"records\":%llu,\"frames_called\":%llu", (unsigned long long)hook->records, (unsigned long long)hook->frames_called);
+			if(analysis->frames != 0){
+				fprintf(out, ",\"calls_per_frame\":{\"mean\":%.3f,\"p50\":%u,\"p99\":%u,\"max\":%llu}", (double)hook->framed_calls / analysis->frames,
+					bin_percentile(hook->call_bins, CALL_BINS + 1, analysis->frames, 0.5), bin_percentile(hook->call_bins, CALL_BINS + 1, analysis->frames, 0.99),
+					(unsigned long long)hook->max_frame_calls);
+			}
+			fputc('}', out);
+		}
+		fprintf(out, "],\"categories\":{");
+		for(int i = 0;i < BINLOG_CATEGORY_COUNT;i++){
+			fprintf(out, "%s\"%s\":{", i == 0 ? "" : ",", binlog_category_names[i]);
+			for(int level = BINLOG_LEVEL_INFO;level < BINLOG_LEVEL_COUNT;level++){
+				fprintf(out, "%s\"%s\":%llu", level == BINLOG_LEVEL_INFO ? "" : ",", binlog_level_names[level], (unsigned long long)analysis->category_records[i][level]);
+			}
+			fputc('}', out);
+		}
+		fprintf(out, "}}\n");
+		return;
+	}
+
+	fprintf(out, "%llu records, %llu dropped\n\n", (unsigned long long)analysis->records, (unsigned long long)dropped);
+	if(analysis->frames == 0){
+		fprintf(out, "no frames, log_limiter has to be verbose for the game tick's records\n\n");
+	}else{
+		fprintf(out, "frametime over %llu frames, in ms\n", (unsigned long long)analysis->frames);
+		fprintf(out, "%8s %8s %8s", "mean", "stddev", "min");
+		for(size_t i = 0;i < SUMMARY_PERCENTILES;i++){
+			fprintf(out, " %8s", summary_percentile_names[i]);
+		}
+		fprintf(out, " %8s\n", "max");
+		fprintf(out, "%8.3f %8.3f %8.3f", mean_ms, stddev_ms, analysis->frametime_min_ns / 1000000.0);
+		for(size_t i = 0;i < SUMMARY_PERCENTILES;i++){
+			fprintf(out, " %8.3f", frametime_percentile_ms(analysis, summary_percentiles[i]));
+		}
+		fprintf(out, " %8.3f\n\n", analysis->frametime_max_ns / 1000000.0);
+	}
+
+	if(analysis->hook_count != 0){
+		fprintf(out, "%-36s %10s %10s %11s %6s %6s %6s\n", "hook", "records", "frames", "calls/frame", "p50", "p99", "max");
+		for(uint32_t i = 0;i < analysis->hook_count;i++){
+			const struct hook_stats *hook = &analysis->hooks[i];
+			fprintf(out, "%-36s %10llu %10llu", hook->name, (unsigned long long)hook->records, (unsigned long long)hook->frames_called);
+			if(analysis->frames != 0){
+				fprintf(out, " %11.3f %6u %6u %6llu\n", (double)hook->framed_calls / analysis->frames, bin_percentile(hook->call_bins, CALL_BINS + 1, analysis->frames, 0.5),
+					bin_percentile(hook->call_bins, CALL_BINS + 1, analysis->frames, 0.99), (unsigned long long)hook->max_frame_calls);
+			}else{
+				fputc('\n', out);
+			}
+		}
+		fputc('\n', out);
+	}
+
+	fprintf(out, "%-12s", "category");
+	for(int level = BINLOG_LEVEL_INFO;level < BINLOG_LEVEL_COUNT;level++){
+		fprintf(out, " %10s", binlog_level_names[level]);
+	}
+	fputc('\n', out);
+	for(int i = 0;i < BINLOG_CATEGORY_COUNT;i++){
+		fprintf(out, "%-12s", binlog_category_names[i]);
+		for(int level = BINLOG_LEVEL_INFO;level < BINLOG_LEVEL_COUNT;level++){
+			fprintf(out, " %10llu", (unsigned long long)analysis->category_records[i][level]);
+		}
+		fputc('\n', out);
+	}
+}
+
+// --check writes a capture of known frames and hook calls through binlog.h, then reads it back through the filters
+static int checks = 0;
+static int failed = 0;
+
+static void check(bool ok, const char *what){
+	checks++;
+	if(!ok){
+		failed++;
+		printf("  failed: %s\n", what);
+	}
+}
+
+#define LOG_AT(category, level, ...) \
+{ \
+	if(__builtin_expect(binlog_on(BINLOG_BIT(category, level)), 0)){ \
+		static uint16_t _binlog_format = 0; \
+		binlog_write(&_binlog_format, category, level, __VA_ARGS__); \
+	} \
+}
+
+#define CHECK_FRAMES 120
+#define CHECK_MOVE_CALLS 3
+
+static uint64_t check_now_ns = 0;
+
+static uint64_t check_clock_ns(){
+	return check_now_ns;
+}
+
+// every 10th frame takes 33ms, the rest 16ms
+static uint64_t check_frame_start_ns(int frame){
+	return (uint64_t)frame * 16000000 + (uint64_t)(frame / 10) * 17000000;
+}
+
+static void write_check_capture(const char *path){
+	int levels[BINLOG_CATEGORY_COUNT];
+	for(int i = 0;i < BINLOG_CATEGORY_COUNT;i++){
+		levels[i] = BINLOG_LEVEL_VERBOSE;
+	}
+	binlog_set_mask(binlog_mask_for(levels));
+	binlog_init(check_clock_ns);
+	// the file stays open after the writer stops, binlog_flush then writes without racing it
+	check(binlog_start(path), "writer starts");
+	binlog_stop();
+
+	LOG_AT(BINLOG_CATEGORY_LIMITER, BINLOG_LEVEL_INFO, "frame limiter now sleeps with %s", "check");
+	for(int frame = 0;frame < CHECK_FRAMES;frame++){
+		check_now_ns = check_frame_start_ns(frame);
+		LOG_AT(BINLOG_CATEGORY_LIMITER, BINLOG_LEVEL_VERBOSE, FRAME_MARKER);
+		for(int call = 0;call < CHECK_MOVE_CALLS;call++){
+			check_now_ns += 100000;
+			LOG_AT(BINLOG_CATEGORY_MOVEMENT, BINLOG_LEVEL_VERBOSE, "%s: ctx 0x%08x, param_1 %f, param_2 %f, param_3 %f", "patched_move_actor_by", (void *)0x1000, 1.0f, call * 0.5f, 3.0f);
+			if(call == 1){
+				LOG_AT(BINLOG_CATEGORY_MOVEMENT, BINLOG_LEVEL_VERBOSE, "%s: applying fly speed fix, y %f, y/param_2 %f", "patched_move_actor_by", 0.5f, 1.0f);
+			}
+		}
+		if(frame % 2 == 0){
+			check_now_ns += 100000;
+			LOG_AT(BINLOG_CATEGORY_FOV, BINLOG_LEVEL_VERBOSE, "%s: ctx 0x%08x, current fov %f, override fov %f", "patched_fun_00766000", (void *)0x2000, 60.0f, 75.0f);
+		}
+		binlog_flush();
+	}
+	binlog_set_mask(0);
+	binlog_flush();
+}
+
+static const struct hook_stats *find_hook(const struct analysis *analysis, const char *name){
+	for(uint32_t i = 0;i < analysis->hook_count;i++){
+		if(strcmp(analysis->hooks[i].name, name) == 0){
+			return &analysis->hooks[i];
+		}
+	}
+	return NULL;
+}
+
+// decodes the check capture once into a temporary file, returns its lines and the analysis
+static bool check_decode(const char *path, const struct filter *filter, enum output_format format, struct analysis *analysis, FILE **lines){
+	memset(analysis, 0, sizeof(struct analysis));
+	FILE *file = fopen(path, "rb");
+	*lines = tmpfile();
+	if(file == NULL || *lines == NULL){
+		return false;
+	}
+	bool ok = decode(file, path, filter, format, *lines, analysis);
+	fclose(file);
+	rewind(*lines);
+	return ok;
+}
+
+static void run_check(const char *path){
+	write_check_capture(path);
+	struct analysis *analysis = (struct analysis *)malloc(sizeof(struct analysis));
+	struct filter filter = {ALL_CATEGORIES, -INFINITY, INFINITY, NULL};
+	FILE *lines;
+	char line[4096];
+
+	check(check_decode(path, &filter, OUTPUT_JSON, analysis, &lines), "the capture reads back to the end");
+	uint64_t line_count = 0;
+	bool lines_ok = true;
+	while(fgets(line, sizeof(line), lines) != NULL){
+		size_t len = strlen(line);
+		lines_ok = lines_ok && len >= 3 && line[0] == '{' && line[len - 2] == '}' && line[len - 1] == '\n';
+		line_count++;
+	}
+	fclose(lines);
+	check(lines_ok, "json records are one object per line");
+	check(line_count == analysis->printed, "every record is written out");
+	check(analysis->records == 1 + CHECK_FRAMES * (1 + CHECK_MOVE_CALLS + 1) + CHECK_FRAMES / 2, "every record is counted");
+
+	check(analysis->frames == CHECK_FRAMES - 1, "frames are delimited by the game tick's records");
+	check(analysis->frametime_min_ns == 16000000 && analysis->frametime_max_ns == 33000000, "frametimes are the time between frames");
+	check(fabs(frametime_percentile_ms(analysis, 0.5) - 16) < 0.01, "frametime percentiles come from the bins");
+	const struct hook_stats *move = find_hook(analysis, "patched_move_actor_by");
+	const struct hook_stats *fov = find_hook(analysis, "patched_fun_00766000");
+	check(analysis->hook_count == 2 && move != NULL && fov != NULL, "hooks are told apart by their name");
+	check(move != NULL && move->frames_called == CHECK_FRAMES - 1 && move->max_frame_calls == CHECK_MOVE_CALLS && move->framed_calls == (CHECK_FRAMES - 1) * CHECK_MOVE_CALLS,
+		"conditional records don't count as calls");
+	check(fov != NULL && fov->frames_called == CHECK_FRAMES / 2 && fov->max_frame_calls == 1, "frames without calls aren't counted as called");
+
+	filter.categories = 1u << BINLOG_CATEGORY_FOV;
+	check_decode(path, &filter, OUTPUT_TEXT, analysis, &lines);
+	fclose(lines);
+	check(analysis->printed == CHECK_FRAMES / 2 && analysis->frames == CHECK_FRAMES - 1, "the category filter keeps frames");
+
+	filter.categories = ALL_CATEGORIES;
+	filter.hook = "move_actor";
+	check_decode(path, &filter, OUTPUT_CSV, analysis, &lines);
+	line_count = 0;
+	while(fgets(line, sizeof(line), lines) != NULL){
+		line_count++;
+	}
+	fclose(lines);
+	check(analysis->printed == CHECK_FRAMES * (CHECK_MOVE_CALLS + 1) && line_count == analysis->printed + 1, "the hook filter matches part of the name");
+
+	filter.hook = NULL;
+	filter.categories = 1u << BINLOG_CATEGORY_LIMITER;
+	filter.from_s = 0.5;
+	filter.to_s = 1.0;
+	check_decode(path, &filter, OUTPUT_TEXT, analysis, &lines);
+	fclose(lines);
+	uint64_t frames_in_range = 0;
+	for(int frame = 0;frame < CHECK_FRAMES;frame++){
+		uint64_t start_ns = check_frame_start_ns(frame);
+		frames_in_range += start_ns >= 500000000 && start_ns <= 1000000000;
+	}
+	check(analysis->printed == frames_in_range && analysis->frames == frames_in_range - 1, "the time range applies to frames too");
+
+	free(analysis);
+}
+
+static void usage(const char *argv0){
+	printf("usage: %s [options] [FILE]\n", argv0);
+	printf("  FILE                 binary log to read, default s4_league_fps_unlock.binlog\n");
+	printf("  --format F           text, csv or json, one object per line, default text\n");
+	printf("  --category C         only records of these categories, comma separated, limiter, movement, spread, fov, config, hooks\n");
+	printf("  --hook NAME          only records of hooks whose name contains NAME\n");
+	printf("  --from S             only records from S seconds after the file's start\n");
+	printf("  --to S               only records up to S seconds after the file's start\n");
+	printf("  --summary            instead of the records, write record counts, the frametime distribution and calls per hook per frame\n");
+	printf("  --check              check the decoder against a capture it writes\n");
+	printf("  --help               show this\n");
+}
+
+int main(int argc, char **argv){
+	const char *path = "s4_league_fps_unlock.binlog";
+	struct filter filter = {ALL_CATEGORIES, -INFINITY, INFINITY, NULL};
+	enum output_format format = OUTPUT_TEXT;
+	bool summary = false;
+	for(int i = 1;i < argc;i++){
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+		if(strcmp(arg, "--help") == 0){
+			usage(argv[0]);
+			return 0;
+		}
+		if(strcmp(arg, "--check") == 0){
+			run_check("binlog_decode_check.binlog");
+			remove("binlog_decode_check.binlog");
+			printf("%d of %d checks passed\n", checks - failed, checks);
+			return failed != 0;
+		}
+		if(strcmp(arg, "--summary") == 0){
+			summary = true;
+			continue;
+		}
+		if(arg[0] != '-'){
+			path = arg;
+			continue;
+		}
+		if(value == NULL){
+			fprintf(stderr, "%s needs a value\n", arg);
+			return 1;
+		}
+		if(strcmp(arg, "--format") == 0){
+			int index = 0;
+			while(index < OUTPUT_COUNT && strcmp(value, output_format_names[index]) != 0){
+				index++;
+			}
+			if(index == OUTPUT_COUNT){
+				fprintf(stderr, "unknown format %s\n", value);
+				return 1;
+			}
+			format = (enum output_format)index;
+		}else if(strcmp(arg, "--category") == 0){
+			filter.categories = 0;
+			char names[256];
+			snprintf(names, sizeof(names), "%s", value);
+			for(char *name = strtok(names, ",");name != NULL;name = strtok(NULL, ",")){
+				int index = 0;
+				while(index < BINLOG_CATEGORY_COUNT && strcmp(name, binlog_category_names[index]) != 0){
+					index++;
+				}
+				if(index == BINLOG_CATEGORY_COUNT){
+					fprintf(stderr, "unknown category %s\n", name);
+					return 1;
+				}
+				filter.categories |= 1u << index;
+			}
+		}else if(strcmp(arg, "--hook") == 0){
+			filter.hook = value;
+		}else if(strcmp(arg, "--from") == 0){
+			filter.from_s = atof(value);
+		}else if(strcmp(arg, "--to") == 0){
+			filter.to_s = atof(value);
+		}else{
+			fprintf(stderr, "unknown option %s\n", arg);
+			usage(argv[0]);
+			return 1;
+		}
+		i++;
+	}
+	if(summary && format == OUTPUT_CSV){
+		fprintf(stderr, "the summary is several tables, write it as text or json\n");
+		return 1;
+	}
+
+	FILE *file = fopen(path, "rb");
+	if(file == NULL){
+		fprintf(stderr, "failed opening %s\n", path);
+		return 1;
+	}
+	// large reads, captures run into gigabytes
+	static char file_buffer[1 << 20];
+	setvbuf(file, file_buffer, _IOFBF, sizeof(file_buffer));
+	struct analysis *analysis = (struct analysis *)calloc(1, sizeof(struct analysis));
+	bool ok = decode(file, path, &filter, format, summary ? NULL : stdout, analysis);
+	fclose(file);
+	if(summary){
+		write_summary(stdout, format, analysis);
+	}
+	free(analysis);
+	return !ok;
+}
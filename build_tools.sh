@@ -0,0 +1,10 @@
+set -xe
+# host tools for working on the frame limiter without the game, not part of the asi
+CPPC=${HOST_CPPC:-c++}
+$CPPC -g -O2 -std=c++20 framelimiter_sim.cpp -o framelimiter_sim -lm
+$CPPC -g -O2 -std=c++20 framelimiter_bench.cpp -o framelimiter_bench -lm
+$CPPC -g -O2 -std=c++20 config_bench.cpp -o config_bench -lm
+$CPPC -g -O2 -std=c++20 control_block_check.cpp -o control_block_check -lm -lpthread
+$CPPC -g -O2 -std=c++20 binlog_check.cpp -o binlog_check -lpthread
+$CPPC -g -O2 -std=c++20 binlog_decode.cpp -o binlog_decode -lm -lpthread
+$CPPC -g -O2 -std=c++20 trace_check.cpp -o trace_check -lpthread
@@ -0,0 +1,369 @@
+// checks and benchmarks the config parser in config_schema.h on the linux build host
+// compares it against the json.hpp based parser the asi used before, on a set of documents and on the shipped config
+// build with build_tools.sh, run with --help for options
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <new>
+#include <string>
+#include <vector>
+#include <time.h>
+
+static bool bench_log = false;
+#define LOG(...) \
+{ \
+	if(bench_log){ \
+		fprintf(stderr, __VA_ARGS__); \
+		fputc('\n', stderr); \
+	} \
+}
+
+#include "config_schema.h"
+#include "json.hpp"
+
+// every heap allocation made by the process, to show what each parser allocates
+static uint64_t allocations = 0;
+
+void *operator new(size_t size){
+	allocations++;
+	void *p = malloc(size ? size : 1);
+	if(p == NULL){
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void *p) noexcept{
+	free(p);
+}
+
+void operator delete(void *p, size_t size) noexcept{
+	free(p);
+}
+
+static uint64_t now_ns(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+// parse_config as it was with json.hpp, returns false where it would have left the config alone
+static bool legacy_parse(struct config *cfg, const char *text, size_t len, const char *source){
+	nlohmann::json parsed_config_file;
+	try{
+		parsed_config_file = nlohmann::json::parse(text, text + len);
+	}catch(const nlohmann::json::exception &e){
+		LOG("failed parsing %s, %s", source, e.what());
+		return false;
+	}
+
+	struct config staging_config;
+	memcpy(&staging_config, cfg, sizeof(struct config));
+	try{
+		if(parsed_config_file["max_framerate"].is_string() && parsed_config_file["max_framerate"] == "auto"){
+			staging_config.max_framerate_auto = true;
+		}else if(!parsed_config_file["max_framerate"].is_number()){
+			LOG("failed reading max_framerate from %s", source);
+		}else{
+			staging_config.max_framerate_auto = false;
+			staging_config.max_framerate = parsed_config_file["max_framerate"];
+		}
+
+		#define LEGACY_READ(name, check) \
+		if(!parsed_config_file[#name].check()){ \
+			LOG("failed reading " #name " from %s", source); \
+		}else{ \
+			staging_config.name = parsed_config_file[#name]; \
+		}
+		#define LEGACY_READ_ENUM(name, names, count, first_value) \
+		if(!parsed_config_file[#name].is_string()){ \
+			LOG("failed reading " #name " from %s", source); \
+		}else{ \
+			std::string value_name = parsed_config_file[#name]; \
+			for(int i = 0;i < count;i++){ \
+				if(value_name == names[i]){ \
+					staging_config.name = first_value + i; \
+				} \
+			} \
+		}
+		LEGACY_READ(framelimiter_auto_offset, is_number)
+		LEGACY_READ(framelimiter_frametime_ns, is_number)
+		LEGACY_READ(field_of_view, is_number)
+		LEGACY_READ(center_field_of_view, is_number)
+		LEGACY_READ(sprint_field_of_view, is_number)
+		LEGACY_READ(framelimiter_full_busy_loop, is_boolean)
+		LEGACY_READ(framelimiter_busy_loop_buffer_100ns, is_number)
+		LEGACY_READ_ENUM(framelimiter_sleep_backend, sleep_backend_config_names, SLEEP_BACKEND_COUNT + 1, SLEEP_BACKEND_AUTO)
+		LEGACY_READ(framelimiter_adaptive_busy_loop, is_boolean)
+		if(!parsed_config_file["framelimiter_busy_loop_budget_percent"].is_number()){
+			LOG("failed reading framelimiter_busy_loop_budget_percent from %s", source);
+		}else{
+			int budget_percent = parsed_config_file["framelimiter_busy_loop_budget_percent"];
+			if(budget_percent >= 0 && budget_percent <= 100){
+				staging_config.framelimiter_busy_loop_budget_percent = budget_percent;
+			}
+		}
+		LEGACY_READ_ENUM(framelimiter_pacing_mode, pacing_mode_names, PACING_MODE_COUNT, 0)
+		LEGACY_READ(framelimiter_jit_margin_100ns, is_number)
+		LEGACY_READ(framelimiter_mmcss, is_boolean)
+		LEGACY_READ(framelimiter_boost_spin_priority, is_boolean)
+		LEGACY_READ(framelimiter_isolate_game_core, is_boolean)
+		LEGACY_READ(high_resolution_frametime, is_boolean)
+		LEGACY_READ(verify_high_resolution_frametime, is_boolean)
+		LEGACY_READ_ENUM(frametime_filter, frametime_filter_names, FRAMETIME_FILTER_COUNT, 0)
+		LEGACY_READ(frametime_filter_ema_alpha, is_number)
+		LEGACY_READ(frametime_filter_median_window, is_number)
+		LEGACY_READ(frametime_filter_clamp_percent, is_number)
+		LEGACY_READ(fixed_frametime_ms, is_number)
+		LEGACY_READ(fixed_frametime_game_delta, is_boolean)
+		#undef LEGACY_READ
+		#undef LEGACY_READ_ENUM
+
+		for(int state = GAME_STATE_LOBBY;state < GAME_STATE_COUNT;state++){
+			struct state_limits *limits = &staging_config.state_limits[state];
+			std::string key = std::string(game_state_names[state]) + "_max_framerate";
+			if(parsed_config_file.contains(key) && parsed_config_file[key].is_number()){
+				limits->max_framerate = parsed_config_file[key];
+			}
+			key = std::string(game_state_names[state]) + "_framelimiter_full_busy_loop";
+			if(parsed_config_file.contains(key) && parsed_config_file[key].is_boolean()){
+				limits->framelimiter_full_busy_loop = parsed_config_file[key] ? 1 : 0;
+			}
+			key = std::string(game_state_names[state]) + "_framelimiter_busy_loop_buffer_100ns";
+			if(parsed_config_file.contains(key) && parsed_config_file[key].is_number()){
+				limits->framelimiter_busy_loop_buffer_100ns = parsed_config_file[key];
+			}
+		}
+	}catch(const nlohmann::json::exception &e){
+		LOG("failed reading %s after parsing, %s", source, e.what());
+	}
+	memcpy(cfg, &staging_config, sizeof(struct config));
+	return true;
+}
+
+// documents both parsers have to agree on, starting from the defaults
+// out of range values that only the schema rejects are left out
+static const char *check_documents[] = {
+	"{}",
+	"{\"max_framerate\":\"auto\",\"framelimiter_auto_offset\":-1.5,\"framelimiter_frametime_ns\":4166666.5}",
+	"{\"max_framerate\":\"automatic\",\"field_of_view\":\"wide\",\"framelimiter_mmcss\":1,\"framelimiter_full_busy_loop\":null}",
+	"{\"max_framerate\":144.5,\"field_of_view\":70.9,\"center_field_of_view\":-3,\"sprint_field_of_view\":1e2}",
+	"{\"framelimiter_sleep_backend\":\"waitable_timer\",\"framelimiter_pacing_mode\":\"just_in_time\",\"frametime_filter\":\"median\"}",
+	"{\"framelimiter_sleep_backend\":\"hibernate\",\"framelimiter_pacing_mode\":7,\"frametime_filter\":\"\"}",
+	"{\"framelimiter_busy_loop_budget_percent\":150,\"framelimiter_adaptive_busy_loop\":true}",
+	"{\"lobby_max_framerate\":60,\"loading_max_framerate\":30,\"unfocused_framelimiter_full_busy_loop\":false,\"minimized_framelimiter_busy_loop_buffer_100ns\":0,\"match_max_framerate\":10}",
+	"{\"lobby_max_framerate\":\"sixty\",\"loading_framelimiter_full_busy_loop\":true,\"lobby_\":1,\"minimized_\":{}}",
+	"{\"unknown\":{\"nested\":[1,2.5e-3,{\"deeper\":[true,false,null]}],\"text\":\"\\\"quoted\\\" \\u00e9\\ud83d\\ude00\"},\"field_of_view\":75}",
+	"{\"field_of_vie\\u0077\":90,\"sprint_field_of_view\":85,\"sprint_field_of_view\":95}",
+	"\xef\xbb\xbf{\"fixed_frametime_ms\":4,\"fixed_frametime_game_delta\":true,\"high_resolution_frametime\":true}",
+	"  {\n\t\"framelimiter_jit_margin_100ns\" : 2500 ,\r\n\"verify_high_resolution_frametime\":true}\n",
+	"{\"max_framerate\":240,}",
+	"{\"max_framerate\":240",
+	"{\"max_framerate\":240}x",
+	"{\"max_framerate\":0240}",
+	"{\"max_framerate\":-}",
+	"{\"max_framerate\":\"unterminated}",
+	"[1,2,3]",
+	"",
+	"{\"profiles\":{\"ranked\":{\"max_framerate\":144,\"hotkey\":\"ctrl+F9\"}},\"active_profile\":\"ranked\",\"field_of_view\":80}",
+};
+
+// a document with profiles, what each profile ends up with is checked by hand
+static const char profile_document[] =
+	"{\"max_framerate\":240,\"field_of_view\":80,\"active_profile\":\"practice\","
+	"\"profiles\":{"
+		"\"practice\":{\"fixed_frametime_ms\":4,\"hotkey\":\"ctrl+shift+F9\"},"
+		"\"lobby\":{\"max_framerate\":60,\"hotkey\":\"alt+numpad5\",\"unknown\":[1]},"
+		"\"practice\":{\"max_framerate\":30},"
+		"\"\":{},"
+		"\"broken\":[],"
+		"\"bad_hotkey\":{\"framelimiter_busy_loop_budget_percent\":200,\"hotkey\":\"F1x\"}"
+	"},\"framelimiter_mmcss\":true}";
+
+static bool check_profiles(){
+	bool ok = true;
+	struct config cfg;
+	memcpy(&cfg, &config_defaults, sizeof(struct config));
+	static struct config_profiles profiles;
+	if(!config_parse(&cfg, &profiles, profile_document, strlen(profile_document), "profile document")){
+		printf("  failed parsing the profile document\n");
+		return false;
+	}
+	#define PROFILE_CHECK(condition) \
+	if(!(condition)){ \
+		printf("  failed: %s\n", #condition); \
+		ok = false; \
+	}
+	PROFILE_CHECK(profiles.count == 3);
+	PROFILE_CHECK(profiles.active == 0);
+	PROFILE_CHECK(cfg.max_framerate == 240 && cfg.field_of_view == 80 && cfg.framelimiter_mmcss);
+	// keys after the profiles still reach them
+	PROFILE_CHECK(profiles.profiles[0].config.framelimiter_mmcss && profiles.profiles[0].config.max_framerate == 240);
+	PROFILE_CHECK(strcmp(profiles.profiles[0].name, "practice") == 0 && profiles.profiles[0].config.fixed_frametime_ms == 4);
+	PROFILE_CHECK(profiles.profiles[0].hotkey_key == 0x78 && profiles.profiles[0].hotkey_modifiers == (CONFIG_HOTKEY_CTRL | CONFIG_HOTKEY_SHIFT));
+	PROFILE_CHECK(strcmp(profiles.profiles[1].name, "lobby") == 0 && profiles.profiles[1].config.max_framerate == 60 && profiles.profiles[1].config.field_of_view == 80);
+	PROFILE_CHECK(profiles.profiles[1].hotkey_key == 0x65 && profiles.profiles[1].hotkey_modifiers == CONFIG_HOTKEY_ALT);
+	PROFILE_CHECK(strcmp(profiles.profiles[2].name, "bad_hotkey") == 0 && profiles.profiles[2].hotkey_key == 0 && profiles.profiles[2].config.framelimiter_busy_loop_budget_percent == config_defaults.framelimiter_busy_loop_budget_percent);
+	#undef PROFILE_CHECK
+	return ok;
+}
+
+static bool same_config(const struct config *a, const struct config *b){
+	return memcmp(a, b, sizeof(struct config)) == 0;
+}
+
+static void print_differences(const struct config *a, const struct config *b){
+	for(int i = 0;i < CONFIG_FIELD_COUNT;i++){
+		const struct config_field *field = &config_fields[i];
+		size_t size = field->kind == CONFIG_KIND_BOOL ? sizeof(bool) : field->kind == CONFIG_KIND_INT || field->kind == CONFIG_KIND_ENUM ? sizeof(int) : sizeof(double);
+		if(memcmp((const char *)a + field->offset, (const char *)b + field->offset, size) != 0){
+			printf("    %s differs\n", field->name);
+		}
+	}
+	if(a->max_framerate_auto != b->max_framerate_auto){
+		printf("    max_framerate_auto differs\n");
+	}
+	if(memcmp(a->state_limits, b->state_limits, sizeof(a->state_limits)) != 0){
+		printf("    state_limits differ\n");
+	}
+}
+
+// both parsers on one document, the config either one ends up with has to match
+static bool check_document(const char *name, const char *text, size_t len){
+	struct config schema_config;
+	memcpy(&schema_config, &config_defaults, sizeof(struct config));
+	struct config legacy_config;
+	memcpy(&legacy_config, &config_defaults, sizeof(struct config));
+	struct config staging_config;
+	memcpy(&staging_config, &config_defaults, sizeof(struct config));
+	if(config_parse(&staging_config, NULL, text, len, name)){
+		memcpy(&schema_config, &staging_config, sizeof(struct config));
+	}
+	legacy_parse(&legacy_config, text, len, name);
+	if(!same_config(&schema_config, &legacy_config)){
+		printf("  mismatch on %s\n", name);
+		print_differences(&schema_config, &legacy_config);
+		return false;
+	}
+	return true;
+}
+
+static bool read_file(const char *path, std::string *content){
+	FILE *f = fopen(path, "rb");
+	if(f == NULL){
+		return false;
+	}
+	char buf[4096];
+	size_t len;
+	while((len = fread(buf, 1, sizeof(buf), f)) > 0){
+		content->append(buf, len);
+	}
+	fclose(f);
+	return true;
+}
+
+static void bench(const char *label, bool (*parse)(struct config *, const char *, size_t, const char *), const std::string &content, int iterations){
+	struct config cfg;
+	memcpy(&cfg, &config_defaults, sizeof(struct config));
+	uint64_t allocations_before = allocations;
+	uint64_t start_ns = now_ns();
+	for(int i = 0;i < iterations;i++){
+		parse(&cfg, content.data(), content.size(), "bench");
+	}
+	uint64_t elapsed_ns = now_ns() - start_ns;
+	printf("%-8s %10.0f ns/parse %10.1f allocations/parse\n", label, (double)elapsed_ns / iterations, (double)(allocations - allocations_before) / iterations);
+}
+
+// the asi's parse, without profiles, in the shape bench takes
+static bool schema_parse(struct config *cfg, const char *text, size_t len, const char *source){
+	return config_parse(cfg, NULL, text, len, source);
+}
+
+static void usage(const char *argv0){
+	printf("usage: %s [options]\n", argv0);
+	printf("  --config FILE        config file to check and time, default s4_league_fps_unlock.json\n");
+	printf("  --iterations N       parses per parser when timing, default 20000\n");
+	printf("  --check              only compare the parsers, exit with 1 when they disagree\n");
+	printf("  --verbose            log what the parsers log to stderr\n");
+}
+
+int main(int argc, char **argv){
+	const char *config_path = "s4_league_fps_unlock.json";
+	int iterations = 20000;
+	bool check_only = false;
+
+	for(int i = 1;i < argc;i++){
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+		if(strcmp(arg, "--verbose") == 0){
+			bench_log = true;
+			continue;
+		}
+		if(strcmp(arg, "--check") == 0){
+			check_only = true;
+			continue;
+		}
+		if(strcmp(arg, "--help") == 0){
+			usage(argv[0]);
+			return 0;
+		}
+		if(value == NULL){
+			fprintf(stderr, "%s needs a value\n", arg);
+			return 1;
+		}
+		if(strcmp(arg, "--config") == 0){
+			config_path = value;
+		}else if(strcmp(arg, "--iterations") == 0){
+			iterations = atoi(value);
+		}else{
+			fprintf(stderr, "unknown option %s\n", arg);
+			usage(argv[0]);
+			return 1;
+		}
+		i++;
+	}
+
+	std::string content;
+	if(!read_file(config_path, &content)){
+		fprintf(stderr, "failed reading %s\n", config_path);
+		return 1;
+	}
+
+	int count = sizeof(check_documents) / sizeof(check_documents[0]);
+	int failed = 0;
+	for(int i = 0;i < count;i++){
+		char name[32];
+		snprintf(name, sizeof(name), "document %d", i);
+		if(!check_document(name, check_documents[i], strlen(check_documents[i]))){
+			failed++;
+		}
+	}
+	if(!check_document(config_path, content.data(), content.size())){
+		failed++;
+	}
+	struct config shipped;
+	memcpy(&shipped, &config_defaults, sizeof(struct config));
+	config_parse(&shipped, NULL, content.data(), content.size(), config_path);
+	if(!same_config(&shipped, &config_defaults)){
+		printf("  %s doesn't match the schema defaults\n", config_path);
+		print_differences(&shipped, &config_defaults);
+		failed++;
+	}
+	if(!check_profiles()){
+		failed++;
+	}
+	printf("%d of %d checks passed\n", count + 3 - failed, count + 3);
+	if(failed != 0){
+		return 1;
+	}
+	if(check_only){
+		return 0;
+	}
+
+	bench("schema", schema_parse, content, iterations);
+	bench("json.hpp", legacy_parse, content, iterations);
+	return 0;
+}
@@ -0,0 +1,882 @@
+// the config file's keys and a streaming parser for them, kept free of windows so the host tools can use it
+// every key is listed once in CONFIG_FIELDS, struct config, its defaults and the parser's field table are generated from that
+// define LOG and LOG_VERBOSE before including to get its messages
+#ifndef CONFIG_SCHEMA_H
+#define CONFIG_SCHEMA_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+#include <climits>
+
+#include "framelimiter.h"
+#include "binlog.h"
+
+// coarse wait implementations available to the frame limiter, the rest of the wait is always spun
+enum sleep_backend_id{
+	SLEEP_BACKEND_AUTO = -1,
+	SLEEP_BACKEND_NT_DELAY = 0,
+	SLEEP_BACKEND_WAITABLE_TIMER,
+	SLEEP_BACKEND_SLEEP,
+	SLEEP_BACKEND_SPIN,
+	SLEEP_BACKEND_COUNT
+};
+// as written in the config file, starting at SLEEP_BACKEND_AUTO
+static const char *sleep_backend_config_names[SLEEP_BACKEND_COUNT + 1] = {
+	"auto",
+	"nt_delay",
+	"waitable_timer",
+	"sleep",
+	"spin",
+};
+
+// what the game is doing, each can have its own frame limiter settings
+enum game_state{
+	// uses the top level frame limiter settings
+	GAME_STATE_MATCH = 0,
+	GAME_STATE_LOBBY,
+	GAME_STATE_LOADING,
+	GAME_STATE_UNFOCUSED,
+	GAME_STATE_MINIMIZED,
+	GAME_STATE_COUNT
+};
+static const char *game_state_names[GAME_STATE_COUNT] = {
+	"match",
+	"lobby",
+	"loading",
+	"unfocused",
+	"minimized",
+};
+
+// how the frame duration the fixes see is smoothed
+enum frametime_filter{
+	// the game's delta as is
+	FRAMETIME_FILTER_RAW = 0,
+	// exponentially weighted moving average
+	FRAMETIME_FILTER_EMA,
+	// median of the last frames
+	FRAMETIME_FILTER_MEDIAN,
+	// raw, but frames too far from the recent average are clamped towards it
+	FRAMETIME_FILTER_CLAMP,
+	FRAMETIME_FILTER_COUNT
+};
+static const char *frametime_filter_names[FRAMETIME_FILTER_COUNT] = {
+	"raw",
+	"ema",
+	"median",
+	"clamp",
+};
+// longest median window
+#define FRAMETIME_FILTER_MAX_WINDOW 15
+
+// top level keys, every one of them is expected in the file
+// FRAMERATE(name, default), a number or "auto", which sets max_framerate_auto instead
+// BOOL(name, default)
+// INT(name, default, min, max), fractions are dropped like a cast would
+// DOUBLE(name, default, min, max)
+// ENUM(name, default, names, name count, value of the first name)
+#define CONFIG_FIELDS(FRAMERATE, BOOL, INT, DOUBLE, ENUM) \
+	/* fractional, 0 disables the frame limiter */ \
+	FRAMERATE(max_framerate, 300) \
+	/* added to the refresh rate with max_framerate_auto */ \
+	DOUBLE(framelimiter_auto_offset, -3, -INFINITY, INFINITY) \
+	/* overrides max_framerate when above 0 */ \
+	DOUBLE(framelimiter_frametime_ns, 0, -INFINITY, INFINITY) \
+	INT(field_of_view, 60, INT_MIN, INT_MAX) \
+	INT(center_field_of_view, 66, INT_MIN, INT_MAX) \
+	INT(sprint_field_of_view, 80, INT_MIN, INT_MAX) \
+	BOOL(framelimiter_full_busy_loop, false) \
+	INT(framelimiter_busy_loop_buffer_100ns, 15000, 0, INT_MAX) \
+	ENUM(framelimiter_sleep_backend, SLEEP_BACKEND_AUTO, sleep_backend_config_names, SLEEP_BACKEND_COUNT + 1, SLEEP_BACKEND_AUTO) \
+	BOOL(framelimiter_adaptive_busy_loop, false) \
+	INT(framelimiter_busy_loop_budget_percent, 50, 0, 100) \
+	ENUM(framelimiter_pacing_mode, PACING_MODE_START, pacing_mode_names, PACING_MODE_COUNT, 0) \
+	INT(framelimiter_jit_margin_100ns, 5000, 0, INT_MAX) \
+	BOOL(framelimiter_mmcss, false) \
+	BOOL(framelimiter_boost_spin_priority, false) \
+	BOOL(framelimiter_isolate_game_core, false) \
+	BOOL(high_resolution_frametime, false) \
+	BOOL(verify_high_resolution_frametime, false) \
+	ENUM(frametime_filter, FRAMETIME_FILTER_RAW, frametime_filter_names, FRAMETIME_FILTER_COUNT, 0) \
+	DOUBLE(frametime_filter_ema_alpha, 0.25, 0, 1) \
+	INT(frametime_filter_median_window, 5, 1, FRAMETIME_FILTER_MAX_WINDOW) \
+	DOUBLE(frametime_filter_clamp_percent, 50, 0, INFINITY) \
+	/* constant frame duration for the fixes when above 0 */ \
+	DOUBLE(fixed_frametime_ms, 0, 0, INFINITY) \
+	BOOL(fixed_frametime_game_delta, false) \
+	/* binary log to s4_league_fps_unlock.binlog */ \
+	BOOL(logging, false) \
+	/* level of each log category while logging, off, info or verbose */ \
+	ENUM(log_limiter, BINLOG_LEVEL_INFO, binlog_level_names, BINLOG_LEVEL_COUNT, 0) \
+	ENUM(log_movement, BINLOG_LEVEL_INFO, binlog_level_names, BINLOG_LEVEL_COUNT, 0) \
+	ENUM(log_spread, BINLOG_LEVEL_INFO, binlog_level_names, BINLOG_LEVEL_COUNT, 0) \
+	ENUM(log_fov, BINLOG_LEVEL_INFO, binlog_level_names, BINLOG_LEVEL_COUNT, 0) \
+	ENUM(log_config, BINLOG_LEVEL_INFO, binlog_level_names, BINLOG_LEVEL_COUNT, 0) \
+	ENUM(log_hooks, BINLOG_LEVEL_INFO, binlog_level_names, BINLOG_LEVEL_COUNT, 0) \
+	/* spans of the limiter, the game tick and the hooks to s4_league_fps_unlock.trace.json */ \
+	BOOL(tracing, false)
+
+// per game state overrides, optional, read from keys prefixed with the state's name, eg. lobby_max_framerate
+// -1 inherits the top level setting, the state doesn't override anything by default
+// DOUBLE(name), TRISTATE(name) a boolean kept as an int so it can be -1, INT(name)
+#define CONFIG_STATE_FIELDS(DOUBLE, TRISTATE, INT) \
+	DOUBLE(max_framerate) \
+	TRISTATE(framelimiter_full_busy_loop) \
+	INT(framelimiter_busy_loop_buffer_100ns)
+
+#define CONFIG_DECLARE_DOUBLE(name, ...) double name;
+#define CONFIG_DECLARE_BOOL(name, ...) bool name;
+#define CONFIG_DECLARE_INT(name, ...) int name;
+
+struct state_limits{
+	CONFIG_STATE_FIELDS(CONFIG_DECLARE_DOUBLE, CONFIG_DECLARE_INT, CONFIG_DECLARE_INT)
+};
+
+struct config{
+	CONFIG_FIELDS(CONFIG_DECLARE_DOUBLE, CONFIG_DECLARE_BOOL, CONFIG_DECLARE_INT, CONFIG_DECLARE_DOUBLE, CONFIG_DECLARE_INT)
+	// follow the monitor's refresh rate plus framelimiter_auto_offset instead of max_framerate
+	bool max_framerate_auto;
+	// GAME_STATE_MATCH's entry is unused
+	struct state_limits state_limits[GAME_STATE_COUNT];
+};
+
+#undef CONFIG_DECLARE_DOUBLE
+#undef CONFIG_DECLARE_BOOL
+#undef CONFIG_DECLARE_INT
+
+#define CONFIG_DEFAULT(name, value, ...) .name = value,
+#define CONFIG_STATE_DEFAULT(name) .name = -1,
+
+static constexpr struct state_limits state_limits_defaults = {
+	CONFIG_STATE_FIELDS(CONFIG_STATE_DEFAULT, CONFIG_STATE_DEFAULT, CONFIG_STATE_DEFAULT)
+};
+
+static constexpr struct config config_defaults = {
+	CONFIG_FIELDS(CONFIG_DEFAULT, CONFIG_DEFAULT, CONFIG_DEFAULT, CONFIG_DEFAULT, CONFIG_DEFAULT)
+	.max_framerate_auto = false,
+	.state_limits = {
+		[GAME_STATE_MATCH] = state_limits_defaults,
+		[GAME_STATE_LOBBY] = state_limits_defaults,
+		[GAME_STATE_LOADING] = state_limits_defaults,
+		[GAME_STATE_UNFOCUSED] = state_limits_defaults,
+		[GAME_STATE_MINIMIZED] = state_limits_defaults,
+	},
+};
+
+#undef CONFIG_DEFAULT
+#undef CONFIG_STATE_DEFAULT
+
+enum config_kind{
+	CONFIG_KIND_FRAMERATE,
+	CONFIG_KIND_BOOL,
+	CONFIG_KIND_TRISTATE,
+	CONFIG_KIND_INT,
+	CONFIG_KIND_DOUBLE,
+	CONFIG_KIND_ENUM,
+};
+
+struct config_field{
+	const char *name;
+	int kind;
+	// into struct config, or struct state_limits for the state fields
+	size_t offset;
+	double min;
+	double max;
+	const char *const *names;
+	int name_count;
+	int first_value;
+};
+
+#define CONFIG_FIELD_FRAMERATE(name, value) {#name, CONFIG_KIND_FRAMERATE, offsetof(struct config, name), -INFINITY, INFINITY, NULL, 0, 0},
+#define CONFIG_FIELD_BOOL(name, value) {#name, CONFIG_KIND_BOOL, offsetof(struct config, name), 0, 0, NULL, 0, 0},
+#define CONFIG_FIELD_INT(name, value, min, max) {#name, CONFIG_KIND_INT, offsetof(struct config, name), min, max, NULL, 0, 0},
+#define CONFIG_FIELD_DOUBLE(name, value, min, max) {#name, CONFIG_KIND_DOUBLE, offsetof(struct config, name), min, max, NULL, 0, 0},
+#define CONFIG_FIELD_ENUM(name, value, names, name_count, first_value) {#name, CONFIG_KIND_ENUM, offsetof(struct config, name), 0, 0, names, name_count, first_value},
+#define CONFIG_STATE_FIELD_DOUBLE(name) {#name, CONFIG_KIND_DOUBLE, offsetof(struct state_limits, name), -INFINITY, INFINITY, NULL, 0, 0},
+#define CONFIG_STATE_FIELD_TRISTATE(name) {#name, CONFIG_KIND_TRISTATE, offsetof(struct state_limits, name), 0, 0, NULL, 0, 0},
+#define CONFIG_STATE_FIELD_INT(name) {#name, CONFIG_KIND_INT, offsetof(struct state_limits, name), INT_MIN, INT_MAX, NULL, 0, 0},
+
+static const struct config_field config_fields[] = {
+	CONFIG_FIELDS(CONFIG_FIELD_FRAMERATE, CONFIG_FIELD_BOOL, CONFIG_FIELD_INT, CONFIG_FIELD_DOUBLE, CONFIG_FIELD_ENUM)
+};
+#define CONFIG_FIELD_COUNT (int)(sizeof(config_fields) / sizeof(config_fields[0]))
+
+static const struct config_field config_state_fields[] = {
+	CONFIG_STATE_FIELDS(CONFIG_STATE_FIELD_DOUBLE, CONFIG_STATE_FIELD_TRISTATE, CONFIG_STATE_FIELD_INT)
+};
+#define CONFIG_STATE_FIELD_COUNT (int)(sizeof(config_state_fields) / sizeof(config_state_fields[0]))
+
+#undef CONFIG_FIELD_FRAMERATE
+#undef CONFIG_FIELD_BOOL
+#undef CONFIG_FIELD_INT
+#undef CONFIG_FIELD_DOUBLE
+#undef CONFIG_FIELD_ENUM
+#undef CONFIG_STATE_FIELD_DOUBLE
+#undef CONFIG_STATE_FIELD_TRISTATE
+#undef CONFIG_STATE_FIELD_INT
+
+// the top level keys seen are tracked in a 64 bit mask
+static_assert(sizeof(config_fields) / sizeof(config_fields[0]) <= 64, "too many config fields for config_parse's seen mask");
+
+// longest key and string value the parser keeps, longer ones are skipped as unknown
+#define CONFIG_READER_MAX_STRING 64
+// longest number text, json doesn't limit it but nothing sensible is longer
+#define CONFIG_READER_MAX_NUMBER 64
+// nesting allowed in values that are skipped
+#define CONFIG_READER_MAX_DEPTH 32
+
+// pull parser over a json document in memory, nothing is allocated
+struct config_reader{
+	const char *start;
+	const char *pos;
+	const char *end;
+	// first syntax error and where it happened, parsing stops there
+	const char *error;
+	const char *error_pos;
+};
+
+static bool config_reader_fail(struct config_reader *r, const char *error){
+	if(r->error == NULL){
+		r->error = error;
+		r->error_pos = r->pos;
+	}
+	return false;
+}
+
+// 0 at the end of the document
+static char config_reader_peek(struct config_reader *r){
+	while(r->pos < r->end && (*r->pos == ' ' || *r->pos == '\t' || *r->pos == '\n' || *r->pos == '\r')){
+		r->pos++;
+	}
+	return r->pos < r->end ? *r->pos : 0;
+}
+
+static bool config_reader_expect(struct config_reader *r, char c){
+	if(config_reader_peek(r) != c){
+		return config_reader_fail(r, "unexpected character");
+	}
+	r->pos++;
+	return true;
+}
+
+static bool config_reader_literal(struct config_reader *r, const char *literal){
+	size_t len = strlen(literal);
+	if((size_t)(r->end - r->pos) < len || memcmp(r->pos, literal, len) != 0){
+		return config_reader_fail(r, "invalid literal");
+	}
+	r->pos += len;
+	return true;
+}
+
+static int config_reader_hex(struct config_reader *r){
+	if(r->end - r->pos < 4){
+		return -1;
+	}
+	int value = 0;
+	for(int i = 0;i < 4;i++){
+		char c = *r->pos++;
+		value <<= 4;
+		if(c >= '0' && c <= '9'){
+			value |= c - '0';
+		}else if(c >= 'a' && c <= 'f'){
+			value |= c - 'a' + 10;
+		}else if(c >= 'A' && c <= 'F'){
+			value |= c - 'A' + 10;
+		}else{
+			return -1;
+		}
+	}
+	return value;
+}
+
+// reads a string with escapes decoded into buf, cut at size - 1 bytes and terminated
+// *len is the full decoded length, so a cut string can be told apart
+static bool config_reader_string(struct config_reader *r, char *buf, size_t size, size_t *len){
+	if(!config_reader_expect(r, '"')){
+		return false;
+	}
+	size_t out = 0;
+	while(true){
+		if(r->pos >= r->end){
+			return config_reader_fail(r, "unterminated string");
+		}
+		unsigned char c = *r->pos++;
+		uint32_t code_point = c;
+		if(c == '"'){
+			break;
+		}
+		if(c < 0x20){
+			return config_reader_fail(r, "control character in string");
+		}
+		if(c == '\\'){
+			if(r->pos >= r->end){
+				return config_reader_fail(r, "unterminated string");
+			}
+			switch(*r->pos++){
+				case '"': code_point = '"'; break;
+				case '\\': code_point = '\\'; break;
+				case '/': code_point = '/'; break;
+				case 'b': code_point = '\b'; break;
+				case 'f': code_point = '\f'; break;
+				case 'n': code_point = '\n'; break;
+				case 'r': code_point = '\r'; break;
+				case 't': code_point = '\t'; break;
+				case 'u':{
+					int unit = config_reader_hex(r);
+					if(unit < 0){
+						return config_reader_fail(r, "invalid unicode escape");
+					}
+					code_point = unit;
+					if(unit >= 0xd800 && unit <= 0xdbff){
+						if(r->end - r->pos < 2 || r->pos[0] != '\\' || r->pos[1] != 'u'){
+							return config_reader_fail(r, "unpaired surrogate");
+						}
+						r->pos += 2;
+						int low = config_reader_hex(r);
+						if(low < 0xdc00 || low > 0xdfff){
+							return config_reader_fail(r, "unpaired surrogate");
+						}
+						code_point = 0x10000 + ((unit - 0xd800) << 10) + (low - 0xdc00);
+					}else if(unit >= 0xdc00 && unit <= 0xdfff){
+						return config_reader_fail(r, "unpaired surrogate");
+					}
+					break;
+				}
+				default:
+					return config_reader_fail(r, "invalid escape");
+			}
+		}
+
+		// raw bytes are copied as is, escaped code points are encoded as utf-8
+		unsigned char encoded[4];
+		int encoded_len = 1;
+		if(c != '\\' || code_point < 0x80){
+			encoded[0] = code_point;
+		}else if(code_point < 0x800){
+			encoded[0] = 0xc0 | (code_point >> 6);
+			encoded[1] = 0x80 | (code_point & 0x3f);
+			encoded_len = 2;
+		}else if(code_point < 0x10000){
+			encoded[0] = 0xe0 | (code_point >> 12);
+			encoded[1] = 0x80 | ((code_point >> 6) & 0x3f);
+			encoded[2] = 0x80 | (code_point & 0x3f);
+			encoded_len = 3;
+		}else{
+			encoded[0] = 0xf0 | (code_point >> 18);
+			encoded[1] = 0x80 | ((code_point >> 12) & 0x3f);
+			encoded[2] = 0x80 | ((code_point >> 6) & 0x3f);
+			encoded[3] = 0x80 | (code_point & 0x3f);
+			encoded_len = 4;
+		}
+		for(int i = 0;i < encoded_len;i++){
+			if(out + 1 < size){
+				buf[out] = encoded[i];
+			}
+			out++;
+		}
+	}
+	if(size > 0){
+		buf[out < size ? out : size - 1] = '\0';
+	}
+	*len = out;
+	return true;
+}
+
+static bool config_reader_is_digit(struct config_reader *r){
+	return r->pos < r->end && *r->pos >= '0' && *r->pos <= '9';
+}
+
+// checks the json number grammar, then converts with strtod from a terminated copy
+static bool config_reader_number(struct config_reader *r, double *value){
+	config_reader_peek(r);
+	const char *begin = r->pos;
+	if(r->pos < r->end && *r->pos == '-'){
+		r->pos++;
+	}
+	if(!config_reader_is_digit(r)){
+		return config_reader_fail(r, "invalid number");
+	}
+	if(*r->pos == '0'){
+		r->pos++;
+	}else{
+		while(config_reader_is_digit(r)){
+			r->pos++;
+		}
+	}
+	if(r->pos < r->end && *r->pos == '.'){
+		r->pos++;
+		if(!config_reader_is_digit(r)){
+			return config_reader_fail(r, "invalid number");
+		}
+		while(config_reader_is_digit(r)){
+			r->pos++;
+		}
+	}
+	if(r->pos < r->end && (*r->pos == 'e' || *r->pos == 'E')){
+		r->pos++;
+		if(r->pos < r->end && (*r->pos == '+' || *r->pos == '-')){
+			r->pos++;
+		}
+		if(!config_reader_is_digit(r)){
+			return config_reader_fail(r, "invalid number");
+		}
+		while(config_reader_is_digit(r)){
+			r->pos++;
+		}
+	}
+	size_t len = r->pos - begin;
+	if(len >= CONFIG_READER_MAX_NUMBER){
+		return config_reader_fail(r, "number too long");
+	}
+	char text[CONFIG_READER_MAX_NUMBER];
+	memcpy(text, begin, len);
+	text[len] = '\0';
+	*value = strtod(text, NULL);
+	return true;
+}
+
+static bool config_reader_skip_value(struct config_reader *r, int depth){
+	if(depth > CONFIG_READER_MAX_DEPTH){
+		return config_reader_fail(r, "nested too deep");
+	}
+	char c = config_reader_peek(r);
+	switch(c){
+		case '"':{
+			char discard[1];
+			size_t len;
+			return config_reader_string(r, discard, sizeof(discard), &len);
+		}
+		case 't':
+			return config_reader_literal(r, "true");
+		case 'f':
+			return config_reader_literal(r, "false");
+		case 'n':
+			return config_reader_literal(r, "null");
+		case '{':
+		case '[':{
+			char close = c == '{' ? '}' : ']';
+			r->pos++;
+			if(config_reader_peek(r) == close){
+				r->pos++;
+				return true;
+			}
+			while(true){
+				if(c == '{'){
+					char discard[1];
+					size_t len;
+					if(!config_reader_string(r, discard, sizeof(discard), &len) || !config_reader_expect(r, ':')){
+						return false;
+					}
+				}
+				if(!config_reader_skip_value(r, depth + 1)){
+					return false;
+				}
+				char next = config_reader_peek(r);
+				if(next == ','){
+					r->pos++;
+				}else if(next == close){
+					r->pos++;
+					return true;
+				}else{
+					return config_reader_fail(r, "expected , or closing bracket");
+				}
+			}
+		}
+		default:{
+			double discard;
+			return config_reader_number(r, &discard);
+		}
+	}
+}
+
+static const struct config_field *config_find_field(const struct config_field *fields, int count, const char *name){
+	for(int i = 0;i < count;i++){
+		if(strcmp(fields[i].name, name) == 0){
+			return &fields[i];
+		}
+	}
+	return NULL;
+}
+
+// reads the value of key into base + field->offset
+// a value of the wrong type, out of range or unknown is consumed and leaves the field alone
+// returns false only on a syntax error
+static bool config_read_field(struct config_reader *r, const struct config_field *field, const char *key, struct config *cfg, char *base, const char *source){
+	char c = config_reader_peek(r);
+	bool is_number = c == '-' || (c >= '0' && c <= '9');
+	bool is_boolean = c == 't' || c == 'f';
+	switch(field->kind){
+		case CONFIG_KIND_BOOL:
+		case CONFIG_KIND_TRISTATE:{
+			if(!is_boolean){
+				break;
+			}
+			bool value = c == 't';
+			if(!config_reader_literal(r, value ? "true" : "false")){
+				return false;
+			}
+			if(field->kind == CONFIG_KIND_BOOL){
+				*(bool *)(base + field->offset) = value;
+			}else{
+				*(int *)(base + field->offset) = value ? 1 : 0;
+			}
+			LOG_VERBOSE("setting %s to %s", key, value ? "true" : "false");
+			return true;
+		}
+		case CONFIG_KIND_FRAMERATE:
+			if(c == '"'){
+				char name[CONFIG_READER_MAX_STRING];
+				size_t len;
+				if(!config_reader_string(r, name, sizeof(name), &len)){
+					return false;
+				}
+				if(strcmp(name, "auto") != 0){
+					LOG("failed reading %s from %s", key, source);
+					return true;
+				}
+				cfg->max_framerate_auto = true;
+				LOG_VERBOSE("setting %s to follow the monitor refresh rate", key);
+				return true;
+			}
+			// fall through
+		case CONFIG_KIND_INT:
+		case CONFIG_KIND_DOUBLE:{
+			if(!is_number){
+				break;
+			}
+			double value;
+			if(!config_reader_number(r, &value)){
+				return false;
+			}
+			if(!(value >= field->min && value <= field->max)){
+				LOG("%s %f in %s is not within %f to %f", key, value, source, field->min, field->max);
+				return true;
+			}
+			if(field->kind == CONFIG_KIND_INT){
+				*(int *)(base + field->offset) = (int)value;
+			}else{
+				*(double *)(base + field->offset) = value;
+			}
+			if(field->kind == CONFIG_KIND_FRAMERATE){
+				cfg->max_framerate_auto = false;
+			}
+			LOG_VERBOSE("setting %s to %f", key, value);
+			return true;
+		}
+		case CONFIG_KIND_ENUM:{
+			if(c != '"'){
+				break;
+			}
+			char name[CONFIG_READER_MAX_STRING];
+			size_t len;
+			if(!config_reader_string(r, name, sizeof(name), &len)){
+				return false;
+			}
+			for(int i = 0;i < field->name_count && len < sizeof(name);i++){
+				if(strcmp(name, field->names[i]) == 0){
+					*(int *)(base + field->offset) = field->first_value + i;
+					LOG_VERBOSE("setting %s to %s", key, name);
+					return true;
+				}
+			}
+			LOG("unknown %s %s in %s", key, name, source);
+			return true;
+		}
+	}
+	LOG("failed reading %s from %s", key, source);
+	return config_reader_skip_value(r, 0);
+}
+
+// named sets of overrides on top of the top level keys, "profiles":{"name":{"key":value, ..., "hotkey":"ctrl+F9"}, ...}
+#define CONFIG_MAX_PROFILES 8
+#define CONFIG_PROFILE_NAME_MAX 32
+
+// modifiers a hotkey can ask for
+enum config_hotkey_modifier{
+	CONFIG_HOTKEY_CTRL = 1 << 0,
+	CONFIG_HOTKEY_ALT = 1 << 1,
+	CONFIG_HOTKEY_SHIFT = 1 << 2,
+};
+
+struct config_profile{
+	char name[CONFIG_PROFILE_NAME_MAX];
+	// windows virtual key code, 0 without a hotkey
+	int hotkey_key;
+	int hotkey_modifiers;
+	// the top level config with this profile's keys applied
+	struct config config;
+};
+
+struct config_profiles{
+	int count;
+	// the one active_profile names, -1 for the top level config
+	int active;
+	struct config_profile profiles[CONFIG_MAX_PROFILES];
+};
+
+// what config_parse_object needs besides the config it fills
+struct config_parse_context{
+	const char *source;
+	// top level fields found
+	uint64_t seen;
+	// NULL except on the top level
+	struct config_profiles *profiles;
+	// where each profile's object is, read after the top level keys it builds on
+	const char *profile_start[CONFIG_MAX_PROFILES];
+	const char *profile_end[CONFIG_MAX_PROFILES];
+	char active_profile[CONFIG_PROFILE_NAME_MAX];
+	// the profile being read, NULL on the top level
+	struct config_profile *profile;
+};
+
+// "F9", "ctrl+shift+P", "alt+numpad1", letters and digits are their own key
+static bool config_parse_hotkey(const char *text, int *key, int *modifiers){
+	*modifiers = 0;
+	while(true){
+		if(strncmp(text, "ctrl+", 5) == 0){
+			*modifiers |= CONFIG_HOTKEY_CTRL;
+			text += 5;
+		}else if(strncmp(text, "alt+", 4) == 0){
+			*modifiers |= CONFIG_HOTKEY_ALT;
+			text += 4;
+		}else if(strncmp(text, "shift+", 6) == 0){
+			*modifiers |= CONFIG_HOTKEY_SHIFT;
+			text += 6;
+		}else{
+			break;
+		}
+	}
+	size_t len = strlen(text);
+	if(len == 1 && ((*text >= 'A' && *text <= 'Z') || (*text >= '0' && *text <= '9'))){
+		*key = *text;
+		return true;
+	}
+	if(len == 1 && *text >= 'a' && *text <= 'z'){
+		*key = *text - 'a' + 'A';
+		return true;
+	}
+	if((text[0] == 'F' || text[0] == 'f') && len >= 2 && len <= 3 && text[1] >= '1' && text[1] <= '9' && (len == 2 || (text[2] >= '0' && text[2] <= '9'))){
+		int n = atoi(text + 1);
+		if(n <= 24){
+			// VK_F1
+			*key = 0x70 + n - 1;
+			return true;
+		}
+	}
+	if(strncmp(text, "numpad", 6) == 0 && len == 7 && text[6] >= '0' && text[6] <= '9'){
+		// VK_NUMPAD0
+		*key = 0x60 + text[6] - '0';
+		return true;
+	}
+	return false;
+}
+
+// remembers where each profile is, they are read once the top level is done
+static bool config_read_profiles(struct config_reader *r, struct config_parse_context *ctx){
+	if(config_reader_peek(r) != '{'){
+		LOG("failed reading profiles from %s", ctx->source);
+		return config_reader_skip_value(r, 0);
+	}
+	r->pos++;
+	if(config_reader_peek(r) == '}'){
+		r->pos++;
+		return true;
+	}
+	while(true){
+		char name[CONFIG_PROFILE_NAME_MAX];
+		size_t name_len;
+		if(!config_reader_string(r, name, sizeof(name), &name_len) || !config_reader_expect(r, ':')){
+			return false;
+		}
+		struct config_profiles *profiles = ctx->profiles;
+		bool duplicate = false;
+		for(int i = 0;i < profiles->count;i++){
+			duplicate = duplicate || strcmp(profiles->profiles[i].name, name) == 0;
+		}
+		int index = -1;
+		if(name_len >= sizeof(name) || name_len == 0){
+			LOG("profile names in %s must be 1 to %d characters", ctx->source, CONFIG_PROFILE_NAME_MAX - 1);
+		}else if(duplicate){
+			LOG("profile %s appears twice in %s, using the first", name, ctx->source);
+		}else if(config_reader_peek(r) != '{'){
+			LOG("failed reading profile %s from %s", name, ctx->source);
+		}else if(profiles->count == CONFIG_MAX_PROFILES){
+			LOG("more than %d profiles in %s, ignoring %s", CONFIG_MAX_PROFILES, ctx->source, name);
+		}else{
+			index = profiles->count++;
+			struct config_profile *profile = &profiles->profiles[index];
+			memset(profile, 0, sizeof(struct config_profile));
+			memcpy(profile->name, name, name_len + 1);
+			ctx->profile_start[index] = r->pos;
+		}
+		if(!config_reader_skip_value(r, 0)){
+			return false;
+		}
+		if(index >= 0){
+			ctx->profile_end[index] = r->pos;
+		}
+
+		char next = config_reader_peek(r);
+		if(next == ','){
+			r->pos++;
+		}else if(next == '}'){
+			r->pos++;
+			return true;
+		}else{
+			return config_reader_fail(r, "expected , or }");
+		}
+	}
+}
+
+// reads the members of a json object into cfg
+// unknown keys are skipped whatever their value, and logged inside profiles
+static bool config_parse_object(struct config_reader *r, struct config *cfg, struct config_parse_context *ctx){
+	if(!config_reader_expect(r, '{')){
+		return false;
+	}
+	if(config_reader_peek(r) == '}'){
+		r->pos++;
+		return true;
+	}
+	while(true){
+		char key[CONFIG_READER_MAX_STRING];
+		size_t key_len;
+		if(!config_reader_string(r, key, sizeof(key), &key_len) || !config_reader_expect(r, ':')){
+			return false;
+		}
+
+		const struct config_field *field = NULL;
+		char *base = NULL;
+		bool read_special = false;
+		bool read = true;
+		if(key_len < sizeof(key)){
+			field = config_find_field(config_fields, CONFIG_FIELD_COUNT, key);
+			if(field != NULL){
+				base = (char *)cfg;
+				ctx->seen |= 1ull << (field - config_fields);
+			}
+			for(int state = GAME_STATE_LOBBY;field == NULL && state < GAME_STATE_COUNT;state++){
+				size_t prefix_len = strlen(game_state_names[state]);
+				if(strncmp(key, game_state_names[state], prefix_len) != 0 || key[prefix_len] != '_'){
+					continue;
+				}
+				field = config_find_field(config_state_fields, CONFIG_STATE_FIELD_COUNT, key + prefix_len + 1);
+				base = (char *)&cfg->state_limits[state];
+			}
+
+			if(field == NULL && ctx->profiles != NULL && strcmp(key, "profiles") == 0){
+				read_special = true;
+				read = config_read_profiles(r, ctx);
+			}else if(field == NULL && ctx->profiles != NULL && strcmp(key, "active_profile") == 0){
+				read_special = true;
+				size_t len = 0;
+				if(config_reader_peek(r) != '"'){
+					LOG("failed reading active_profile from %s", ctx->source);
+					read = config_reader_skip_value(r, 0);
+				}else{
+					read = config_reader_string(r, ctx->active_profile, sizeof(ctx->active_profile), &len);
+				}
+			}else if(field == NULL && ctx->profile != NULL && strcmp(key, "hotkey") == 0){
+				read_special = true;
+				char hotkey[CONFIG_READER_MAX_STRING];
+				size_t len = 0;
+				if(config_reader_peek(r) != '"'){
+					LOG("failed reading hotkey of profile %s from %s", ctx->profile->name, ctx->source);
+					read = config_reader_skip_value(r, 0);
+				}else if((read = config_reader_string(r, hotkey, sizeof(hotkey), &len)) && !config_parse_hotkey(hotkey, &ctx->profile->hotkey_key, &ctx->profile->hotkey_modifiers)){
+					LOG("unknown hotkey %s for profile %s in %s", hotkey, ctx->profile->name, ctx->source);
+					ctx->profile->hotkey_key = 0;
+					ctx->profile->hotkey_modifiers = 0;
+				}
+			}
+		}
+
+		if(field != NULL){
+			read = config_read_field(r, field, key, cfg, base, ctx->source);
+		}else if(!read_special){
+			if(ctx->profile != NULL){
+				LOG("unknown key %s in profile %s of %s", key, ctx->profile->name, ctx->source);
+			}
+			read = config_reader_skip_value(r, 0);
+		}
+		if(!read){
+			return false;
+		}
+
+		char next = config_reader_peek(r);
+		if(next == ','){
+			r->pos++;
+		}else if(next == '}'){
+			r->pos++;
+			return true;
+		}else{
+			return config_reader_fail(r, "expected , or }");
+		}
+	}
+}
+
+// fills cfg from the json document in text[0, len), source names it in the log
+// keys that are missing, invalid or out of range keep what cfg had
+// profiles, when not NULL, gets every profile as the resulting cfg with the profile's keys applied, and which one is active
+// returns false on a syntax error, cfg and profiles are then partially updated and should be thrown away
+static bool config_parse(struct config *cfg, struct config_profiles *profiles, const char *text, size_t len, const char *source){
+	struct config_reader r = {text, text, text + len, NULL, NULL};
+	// utf-8 byte order mark
+	if(len >= 3 && memcmp(text, "\xef\xbb\xbf", 3) == 0){
+		r.pos += 3;
+	}
+	struct config_parse_context ctx;
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.source = source;
+	ctx.profiles = profiles;
+	if(profiles != NULL){
+		profiles->count = 0;
+		profiles->active = -1;
+	}
+	if(config_parse_object(&r, cfg, &ctx) && config_reader_peek(&r) != 0){
+		config_reader_fail(&r, "trailing characters");
+	}
+	if(r.error != NULL){
+		int line = 1;
+		const char *line_start = r.start;
+		for(const char *p = r.start;p < r.error_pos;p++){
+			if(*p == '\n'){
+				line++;
+				line_start = p + 1;
+			}
+		}
+		LOG("failed parsing %s, %s at line %d column %d", source, r.error, line, (int)(r.error_pos - line_start) + 1);
+		return false;
+	}
+	for(int i = 0;i < CONFIG_FIELD_COUNT;i++){
+		if(!(ctx.seen & (1ull << i))){
+			LOG("failed reading %s from %s", config_fields[i].name, source);
+		}
+	}
+	if(profiles == NULL){
+		return true;
+	}
+
+	// the text was already checked while skipping over the profiles, this only applies their keys
+	for(int i = 0;i < profiles->count;i++){
+		struct config_profile *profile = &profiles->profiles[i];
+		memcpy(&profile->config, cfg, sizeof(struct config));
+		struct config_reader profile_reader = {text, ctx.profile_start[i], ctx.profile_end[i], NULL, NULL};
+		struct config_parse_context profile_ctx;
+		memset(&profile_ctx, 0, sizeof(profile_ctx));
+		profile_ctx.source = source;
+		profile_ctx.profile = profile;
+		config_parse_object(&profile_reader, &profile->config, &profile_ctx);
+		if(strcmp(profile->name, ctx.active_profile) == 0){
+			profiles->active = i;
+		}
+	}
+	if(ctx.active_profile[0] != '\0' && profiles->active < 0){
+		LOG("active_profile %s is not in the profiles of %s", ctx.active_profile, source);
+	}
+	return true;
+}
+
+#endif // CONFIG_SCHEMA_H
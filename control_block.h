@@ -0,0 +1,373 @@
+// layout of the shared memory block the asi creates at startup for external tools, eg. a launcher or an overlay
+// tools read the config in effect and what the game is doing from it, and ask for config changes without touching the json
+// header only, the asi, tools and control_block_check.cpp share it, windows is only needed for the open helpers at the bottom
+#ifndef CONTROL_BLOCK_H
+#define CONTROL_BLOCK_H
+
+#include "config_schema.h"
+
+#define CONTROL_BLOCK_NAME "Local\\s4_league_fps_unlock"
+// auto reset, set by a tool after it wrote a request
+#define CONTROL_EVENT_NAME "Local\\s4_league_fps_unlock_control"
+// "S4FP"
+#define CONTROL_BLOCK_MAGIC 0x50463453u
+// bump whenever the layout below changes, which includes adding config fields to config_schema.h
+#define CONTROL_BLOCK_VERSION 5
+
+// how often each fix kicked in, counted by the hooks
+enum control_fix{
+	CONTROL_FIX_FLY = 0,
+	CONTROL_FIX_SCYTHE_UPPERCUT,
+	CONTROL_FIX_PS_DROP,
+	CONTROL_FIX_SPREAD,
+	CONTROL_FIX_FOV,
+	CONTROL_FIX_COUNT
+};
+static const char *control_fix_names[CONTROL_FIX_COUNT] = {
+	"fly",
+	"scythe_uppercut",
+	"ps_drop",
+	"spread",
+	"fov",
+};
+// room for more fixes without a layout change
+#define CONTROL_FIX_SLOTS 8
+static_assert(CONTROL_FIX_COUNT <= CONTROL_FIX_SLOTS, "too many fixes for the status block");
+
+// every value takes 8 bytes, so 32 and 64 bit readers see the same offsets whatever their alignment rules
+#define CONTROL_DECLARE_DOUBLE(name, ...) double name;
+#define CONTROL_DECLARE_INT(name, ...) int64_t name;
+
+struct control_state_limits{
+	CONFIG_STATE_FIELDS(CONTROL_DECLARE_DOUBLE, CONTROL_DECLARE_INT, CONTROL_DECLARE_INT)
+};
+
+// struct config with fixed width members, booleans and enums are integers
+struct control_config{
+	CONFIG_FIELDS(CONTROL_DECLARE_DOUBLE, CONTROL_DECLARE_INT, CONTROL_DECLARE_INT, CONTROL_DECLARE_DOUBLE, CONTROL_DECLARE_INT)
+	int64_t max_framerate_auto;
+	struct control_state_limits state_limits[GAME_STATE_COUNT];
+};
+
+#undef CONTROL_DECLARE_DOUBLE
+#undef CONTROL_DECLARE_INT
+
+// what the game thread saw on its last frame
+struct control_status{
+	uint64_t frame_count;
+	// frame limiter clock when this was written
+	uint64_t updated_ns;
+	// handed to the fixes, and as measured before the frametime filter
+	double frametime_ms;
+	double raw_frametime_ms;
+	// 0 while the frame limiter is off
+	uint64_t target_frametime_ns;
+	// how long orig_game_tick took
+	uint64_t tick_ns;
+	// how late the frame limiter's last coarse sleep woke up
+	uint64_t last_wake_late_ns;
+	// 1 when the frame limiter waited before this frame
+	int64_t limiting;
+	int64_t game_state;
+	int64_t sleep_backend;
+	int64_t pacing_mode;
+	// since startup, indexed by control_fix
+	uint64_t fix_counts[CONTROL_FIX_SLOTS];
+};
+
+struct control_block{
+	// written last by the asi, a block without it is not ready
+	uint32_t magic;
+	uint32_t version;
+	// sizeof(struct control_block) of the asi
+	uint32_t size;
+	// of the game
+	uint32_t process_id;
+	// seqlocks, odd while the part they guard is being written
+	uint32_t config_seq;
+	uint32_t request_seq;
+	uint32_t status_seq;
+	uint32_t profile_seq;
+	// the config in effect, written by the asi whenever it changes
+	struct control_config config;
+	// what a tool wants the config to be, the asi validates and applies it once CONTROL_EVENT_NAME is set
+	struct control_config request;
+	// written by the game thread every frame
+	struct control_status status;
+	// a profile of the json a tool wants in effect, empty for the top level keys, applied like a hotkey once CONTROL_EVENT_NAME is set
+	char profile_request[CONFIG_PROFILE_NAME_MAX];
+};
+
+static_assert(sizeof(struct control_config) == (CONFIG_FIELD_COUNT + 1 + GAME_STATE_COUNT * CONFIG_STATE_FIELD_COUNT) * 8, "control_config has padding");
+static_assert(sizeof(struct control_status) == (11 + CONTROL_FIX_SLOTS) * 8, "control_status has padding");
+static_assert(offsetof(struct control_block, config) == 32, "control_block header changed");
+static_assert(offsetof(struct control_block, request) == 32 + sizeof(struct control_config), "control_block layout changed");
+static_assert(offsetof(struct control_block, status) == 32 + 2 * sizeof(struct control_config), "control_block layout changed");
+static_assert(offsetof(struct control_block, profile_request) == 32 + 2 * sizeof(struct control_config) + sizeof(struct control_status), "control_block layout changed");
+static_assert(CONFIG_PROFILE_NAME_MAX % 8 == 0, "profile_request leaves padding");
+// version 5, bump CONTROL_BLOCK_VERSION before updating this
+static_assert(sizeof(struct control_block) == 984, "control_block layout changed, bump CONTROL_BLOCK_VERSION");
+
+#define CONTROL_OFFSET(name, ...) offsetof(struct control_config, name),
+#define CONTROL_STATE_OFFSET(name) offsetof(struct control_state_limits, name),
+// where each of config_fields and config_state_fields lives in control_config
+static const size_t control_config_offsets[] = {
+	CONFIG_FIELDS(CONTROL_OFFSET, CONTROL_OFFSET, CONTROL_OFFSET, CONTROL_OFFSET, CONTROL_OFFSET)
+};
+static const size_t control_state_offsets[] = {
+	CONFIG_STATE_FIELDS(CONTROL_STATE_OFFSET, CONTROL_STATE_OFFSET, CONTROL_STATE_OFFSET)
+};
+#undef CONTROL_OFFSET
+#undef CONTROL_STATE_OFFSET
+static_assert(sizeof(control_config_offsets) / sizeof(size_t) == CONFIG_FIELD_COUNT, "control_config_offsets doesn't match config_fields");
+static_assert(sizeof(control_state_offsets) / sizeof(size_t) == CONFIG_STATE_FIELD_COUNT, "control_state_offsets doesn't match config_state_fields");
+
+static void control_field_from_config(const struct config_field *field, char *slot, const char *base){
+	switch(field->kind){
+		case CONFIG_KIND_BOOL:{
+			int64_t value = *(const bool *)(base + field->offset);
+			memcpy(slot, &value, sizeof(value));
+			break;
+		}
+		case CONFIG_KIND_TRISTATE:
+		case CONFIG_KIND_INT:
+		case CONFIG_KIND_ENUM:{
+			int64_t value = *(const int *)(base + field->offset);
+			memcpy(slot, &value, sizeof(value));
+			break;
+		}
+		default:
+			memcpy(slot, base + field->offset, sizeof(double));
+			break;
+	}
+}
+
+static void control_config_from_config(struct control_config *out, const struct config *cfg){
+	memset(out, 0, sizeof(struct control_config));
+	for(int i = 0;i < CONFIG_FIELD_COUNT;i++){
+		control_field_from_config(&config_fields[i], (char *)out + control_config_offsets[i], (const char *)cfg);
+	}
+	out->max_framerate_auto = cfg->max_framerate_auto;
+	for(int state = 0;state < GAME_STATE_COUNT;state++){
+		for(int i = 0;i < CONFIG_STATE_FIELD_COUNT;i++){
+			control_field_from_config(&config_state_fields[i], (char *)&out->state_limits[state] + control_state_offsets[i], (const char *)&cfg->state_limits[state]);
+		}
+	}
+}
+
+// copies one value from slot into base if the schema allows it, returns false otherwise
+static bool control_field_to_config(const struct config_field *field, const char *slot, char *base){
+	int64_t int_value;
+	double double_value;
+	memcpy(&int_value, slot, sizeof(int_value));
+	memcpy(&double_value, slot, sizeof(double_value));
+	switch(field->kind){
+		case CONFIG_KIND_BOOL:
+			if(int_value != 0 && int_value != 1){
+				return false;
+			}
+			*(bool *)(base + field->offset) = int_value;
+			return true;
+		case CONFIG_KIND_TRISTATE:
+			if(int_value < -1 || int_value > 1){
+				return false;
+			}
+			*(int *)(base + field->offset) = int_value;
+			return true;
+		case CONFIG_KIND_INT:
+			if(!(int_value >= field->min && int_value <= field->max)){
+				return false;
+			}
+			*(int *)(base + field->offset) = int_value;
+			return true;
+		case CONFIG_KIND_ENUM:
+			if(int_value < field->first_value || int_value >= field->first_value + field->name_count){
+				return false;
+			}
+			*(int *)(base + field->offset) = int_value;
+			return true;
+		default:
+			if(!(double_value >= field->min && double_value <= field->max)){
+				return false;
+			}
+			*(double *)(base + field->offset) = double_value;
+			return true;
+	}
+}
+
+// copies the values of request the schema allows into cfg, the others are logged and keep what cfg had
+static void control_config_apply(struct config *cfg, const struct control_config *request, const char *source){
+	for(int i = 0;i < CONFIG_FIELD_COUNT;i++){
+		if(!control_field_to_config(&config_fields[i], (const char *)request + control_config_offsets[i], (char *)cfg)){
+			LOG("invalid %s in %s", config_fields[i].name, source);
+		}
+	}
+	if(request->max_framerate_auto == 0 || request->max_framerate_auto == 1){
+		cfg->max_framerate_auto = request->max_framerate_auto;
+	}else{
+		LOG("invalid max_framerate_auto in %s", source);
+	}
+	for(int state = GAME_STATE_LOBBY;state < GAME_STATE_COUNT;state++){
+		for(int i = 0;i < CONFIG_STATE_FIELD_COUNT;i++){
+			if(!control_field_to_config(&config_state_fields[i], (const char *)&request->state_limits[state] + control_state_offsets[i], (char *)&cfg->state_limits[state])){
+				LOG("invalid %s_%s in %s", game_state_names[state], config_state_fields[i].name, source);
+			}
+		}
+	}
+}
+
+static void control_pause(){
+	#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+	#elif defined(__aarch64__)
+	asm volatile("yield");
+	#endif
+}
+
+// seqlock over size bytes at dst, only one writer at a time
+static void control_seqlock_write(uint32_t *seq, void *dst, const void *src, size_t size){
+	uint32_t current = __atomic_load_n(seq, __ATOMIC_RELAXED);
+	__atomic_store_n(seq, current + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(dst, src, size);
+	__atomic_store_n(seq, current + 2, __ATOMIC_RELEASE);
+}
+
+// copies a consistent version of size bytes at src, returns its sequence number
+// gives up and returns an odd number after tries attempts saw a write in progress, a writer that died halfway never finishes
+static uint32_t control_seqlock_read(const uint32_t *seq, void *dst, const void *src, size_t size, int tries){
+	uint32_t published = 1;
+	for(int i = 0;i < tries;i++){
+		published = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+		if(published & 1){
+			control_pause();
+			continue;
+		}
+		memcpy(dst, src, size);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if(__atomic_load_n(seq, __ATOMIC_RELAXED) == published){
+			return published;
+		}
+	}
+	return published | 1;
+}
+
+#define CONTROL_READ_TRIES 100000
+
+// whether block was finished by an asi with this exact layout
+static bool control_block_valid(const struct control_block *block){
+	return __atomic_load_n(&block->magic, __ATOMIC_ACQUIRE) == CONTROL_BLOCK_MAGIC &&
+		block->version == CONTROL_BLOCK_VERSION && block->size == sizeof(struct control_block);
+}
+
+static bool control_block_read_config(const struct control_block *block, struct control_config *out){
+	return !(control_seqlock_read(&block->config_seq, out, &block->config, sizeof(struct control_config), CONTROL_READ_TRIES) & 1);
+}
+
+static bool control_block_read_status(const struct control_block *block, struct control_status *out){
+	return !(control_seqlock_read(&block->status_seq, out, &block->status, sizeof(struct control_status), CONTROL_READ_TRIES) & 1);
+}
+
+// seqlock write for parts tools write, they may race each other, the sequence counter is taken with a compare and swap
+static bool control_seqlock_write_shared(uint32_t *seq, void *dst, const void *src, size_t size){
+	for(int i = 0;i < CONTROL_READ_TRIES;i++){
+		uint32_t current = __atomic_load_n(seq, __ATOMIC_RELAXED);
+		if(!(current & 1) && __atomic_compare_exchange_n(seq, &current, current + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+			__atomic_thread_fence(__ATOMIC_RELEASE);
+			memcpy(dst, src, size);
+			__atomic_store_n(seq, current + 2, __ATOMIC_RELEASE);
+			return true;
+		}
+		control_pause();
+	}
+	return false;
+}
+
+// asi side of a part tools write, *last is the sequence last read, returns true when there was a newer version
+static bool control_seqlock_read_new(const uint32_t *seq, void *dst, const void *src, size_t size, uint32_t *last){
+	if(__atomic_load_n(seq, __ATOMIC_ACQUIRE) == *last){
+		return false;
+	}
+	uint32_t published = control_seqlock_read(seq, dst, src, size, CONTROL_READ_TRIES);
+	if(published & 1){
+		return false;
+	}
+	*last = published;
+	return true;
+}
+
+// asks for a new config, usually control_block_read_config, changed, then this, then control_block_notify
+// tools may race each other here, the last request written wins
+static bool control_block_write_request(struct control_block *block, const struct control_config *request){
+	return control_seqlock_write_shared(&block->request_seq, &block->request, request, sizeof(struct control_config));
+}
+
+// asi side, *seq is the last request read, returns true when there was a newer one
+static bool control_block_read_request(const struct control_block *block, struct control_config *out, uint32_t *seq){
+	return control_seqlock_read_new(&block->request_seq, out, &block->request, sizeof(struct control_config), seq);
+}
+
+// asks for a profile of the json by name, "" for the top level keys, then control_block_notify
+// unlike a config request it survives saving the json, the asi keeps the profile the way it keeps one picked with a hotkey
+static bool control_block_write_profile_request(struct control_block *block, const char *name){
+	char request[CONFIG_PROFILE_NAME_MAX] = {0};
+	size_t len = strlen(name);
+	if(len >= CONFIG_PROFILE_NAME_MAX){
+		return false;
+	}
+	memcpy(request, name, len);
+	return control_seqlock_write_shared(&block->profile_seq, block->profile_request, request, CONFIG_PROFILE_NAME_MAX);
+}
+
+// asi side, *seq is the last profile request read, out always ends up terminated
+static bool control_block_read_profile_request(const struct control_block *block, char *out, uint32_t *seq){
+	if(!control_seqlock_read_new(&block->profile_seq, out, block->profile_request, CONFIG_PROFILE_NAME_MAX, seq)){
+		return false;
+	}
+	out[CONFIG_PROFILE_NAME_MAX - 1] = '\0';
+	return true;
+}
+
+// asi side, the caller serializes the writers of each part
+static void control_block_write_config(struct control_block *block, const struct control_config *cfg){
+	control_seqlock_write(&block->config_seq, &block->config, cfg, sizeof(struct control_config));
+}
+
+static void control_block_write_status(struct control_block *block, const struct control_status *status){
+	control_seqlock_write(&block->status_seq, &block->status, status, sizeof(struct control_status));
+}
+
+#ifdef _WIN32
+// maps the block of the running game, NULL when the game isn't running or its layout is not the one here
+static struct control_block *control_block_open(){
+	HANDLE mapping = OpenFileMappingA(FILE_MAP_READ | FILE_MAP_WRITE, false, CONTROL_BLOCK_NAME);
+	if(mapping == NULL){
+		return NULL;
+	}
+	// the view keeps the mapping alive
+	struct control_block *block = (struct control_block *)MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof(struct control_block));
+	CloseHandle(mapping);
+	if(block != NULL && !control_block_valid(block)){
+		UnmapViewOfFile(block);
+		return NULL;
+	}
+	return block;
+}
+
+static void control_block_close(struct control_block *block){
+	UnmapViewOfFile(block);
+}
+
+// tells the asi that a request was written
+static bool control_block_notify(){
+	HANDLE event = OpenEventA(EVENT_MODIFY_STATE, false, CONTROL_EVENT_NAME);
+	if(event == NULL){
+		return false;
+	}
+	bool set = SetEvent(event);
+	CloseHandle(event);
+	return set;
+}
+#endif // _WIN32
+
+#endif // CONTROL_BLOCK_H
@@ -0,0 +1,294 @@
+// checks the shared memory layout and sequence protocol in control_block.h on the linux build host
+// the block lives in ordinary memory here, threads play the asi, the game thread and competing tools
+// build with build_tools.sh, run with --help for options
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <pthread.h>
+#include <time.h>
+
+static bool check_log = false;
+#define LOG(...) \
+{ \
+	if(check_log){ \
+		fprintf(stderr, __VA_ARGS__); \
+		fputc('\n', stderr); \
+	} \
+}
+
+#include "control_block.h"
+
+static int checks = 0;
+static int failed = 0;
+
+static void check(bool ok, const char *what){
+	checks++;
+	if(!ok){
+		failed++;
+		printf("  failed: %s\n", what);
+	}
+}
+
+static uint64_t now_ns(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+static void check_layout(){
+	printf("control_block is %zu bytes, config at %zu, request at %zu, status at %zu\n", sizeof(struct control_block),
+		offsetof(struct control_block, config), offsetof(struct control_block, request), offsetof(struct control_block, status));
+	for(int i = 0;i < CONFIG_FIELD_COUNT;i++){
+		check(control_config_offsets[i] % 8 == 0, "config fields are 8 byte aligned");
+	}
+
+	// everything survives a round trip through the block's format
+	struct config cfg;
+	memcpy(&cfg, &config_defaults, sizeof(struct config));
+	cfg.max_framerate = 237.5;
+	cfg.max_framerate_auto = true;
+	cfg.field_of_view = 75;
+	cfg.framelimiter_sleep_backend = SLEEP_BACKEND_WAITABLE_TIMER;
+	cfg.framelimiter_mmcss = true;
+	cfg.state_limits[GAME_STATE_LOBBY].max_framerate = 60;
+	cfg.state_limits[GAME_STATE_MINIMIZED].framelimiter_full_busy_loop = 0;
+	struct control_config block_config;
+	control_config_from_config(&block_config, &cfg);
+	check(block_config.max_framerate == 237.5 && block_config.field_of_view == 75 && block_config.framelimiter_sleep_backend == SLEEP_BACKEND_WAITABLE_TIMER, "values keep their meaning in the block");
+	struct config round_trip;
+	memcpy(&round_trip, &config_defaults, sizeof(struct config));
+	control_config_apply(&round_trip, &block_config, "round trip");
+	check(memcmp(&round_trip, &cfg, sizeof(struct config)) == 0, "config round trips through control_config");
+
+	// invalid values are refused one by one, valid ones next to them still go through
+	struct control_config request = block_config;
+	request.framelimiter_mmcss = 2;
+	request.framelimiter_busy_loop_budget_percent = 150;
+	request.framelimiter_pacing_mode = PACING_MODE_COUNT;
+	request.framelimiter_sleep_backend = SLEEP_BACKEND_AUTO - 1;
+	request.frametime_filter_ema_alpha = NAN;
+	request.state_limits[GAME_STATE_LOBBY].framelimiter_full_busy_loop = 5;
+	request.field_of_view = 90;
+	struct config applied;
+	memcpy(&applied, &cfg, sizeof(struct config));
+	control_config_apply(&applied, &request, "invalid request");
+	check(applied.framelimiter_mmcss == cfg.framelimiter_mmcss, "booleans other than 0 and 1 are refused");
+	check(applied.framelimiter_busy_loop_budget_percent == cfg.framelimiter_busy_loop_budget_percent, "out of range integers are refused");
+	check(applied.framelimiter_pacing_mode == cfg.framelimiter_pacing_mode && applied.framelimiter_sleep_backend == cfg.framelimiter_sleep_backend, "unknown enum values are refused");
+	check(applied.frametime_filter_ema_alpha == cfg.frametime_filter_ema_alpha, "nan is refused");
+	check(applied.state_limits[GAME_STATE_LOBBY].framelimiter_full_busy_loop == cfg.state_limits[GAME_STATE_LOBBY].framelimiter_full_busy_loop, "state overrides are validated");
+	check(applied.field_of_view == 90, "valid fields of a partly invalid request apply");
+}
+
+// every value written is derived from one counter, so a torn copy shows up as a mismatch
+static void fill_status(struct control_status *status, uint64_t n){
+	status->frame_count = n;
+	status->updated_ns = n * 3;
+	status->frametime_ms = n * 0.5;
+	status->raw_frametime_ms = n * 0.25;
+	status->target_frametime_ns = n * 7;
+	status->tick_ns = n * 11;
+	status->last_wake_late_ns = n * 13;
+	status->limiting = n & 1;
+	status->game_state = n % GAME_STATE_COUNT;
+	status->sleep_backend = n % SLEEP_BACKEND_COUNT;
+	status->pacing_mode = n % PACING_MODE_COUNT;
+	for(int i = 0;i < CONTROL_FIX_SLOTS;i++){
+		status->fix_counts[i] = n + i;
+	}
+}
+
+static bool status_consistent(const struct control_status *status){
+	struct control_status expected;
+	fill_status(&expected, status->frame_count);
+	return memcmp(&expected, status, sizeof(struct control_status)) == 0;
+}
+
+static void fill_request(struct control_config *request, int64_t n){
+	int64_t *slots = (int64_t *)request;
+	for(size_t i = 0;i < sizeof(struct control_config) / sizeof(int64_t);i++){
+		slots[i] = n;
+	}
+}
+
+static bool request_consistent(const struct control_config *request){
+	const int64_t *slots = (const int64_t *)request;
+	for(size_t i = 1;i < sizeof(struct control_config) / sizeof(int64_t);i++){
+		if(slots[i] != slots[0]){
+			return false;
+		}
+	}
+	return true;
+}
+
+static struct control_block block;
+static uint64_t stress_end_ns;
+
+struct stress_counts{
+	uint64_t reads;
+	uint64_t torn;
+	uint64_t given_up;
+};
+
+// the game thread, writes the status as fast as it can
+static void *status_writer(void *arg){
+	struct control_status status;
+	for(uint64_t n = 1;now_ns() < stress_end_ns;n++){
+		fill_status(&status, n);
+		control_block_write_status(&block, &status);
+	}
+	return NULL;
+}
+
+// an overlay polling the status
+static void *status_reader(void *arg){
+	struct stress_counts *counts = (struct stress_counts *)arg;
+	struct control_status status;
+	while(now_ns() < stress_end_ns){
+		if(!control_block_read_status(&block, &status)){
+			counts->given_up++;
+			continue;
+		}
+		counts->reads++;
+		if(!status_consistent(&status)){
+			counts->torn++;
+		}
+	}
+	return NULL;
+}
+
+// a tool writing requests, racing the other one
+static void *request_writer(void *arg){
+	int64_t base = (int64_t)(intptr_t)arg;
+	struct control_config request;
+	for(int64_t n = 0;now_ns() < stress_end_ns;n++){
+		fill_request(&request, base + n * 2);
+		control_block_write_request(&block, &request);
+	}
+	return NULL;
+}
+
+// the asi's main thread picking up requests
+static void *request_reader(void *arg){
+	struct stress_counts *counts = (struct stress_counts *)arg;
+	struct control_config request;
+	uint32_t seq = 0;
+	while(now_ns() < stress_end_ns){
+		if(!control_block_read_request(&block, &request, &seq)){
+			continue;
+		}
+		counts->reads++;
+		if(!request_consistent(&request)){
+			counts->torn++;
+		}
+	}
+	return NULL;
+}
+
+static void check_protocol(double seconds){
+	memset(&block, 0, sizeof(block));
+	check(!control_block_valid(&block), "a block without magic is not valid");
+	block.version = CONTROL_BLOCK_VERSION;
+	block.size = sizeof(struct control_block);
+	__atomic_store_n(&block.magic, CONTROL_BLOCK_MAGIC, __ATOMIC_RELEASE);
+	check(control_block_valid(&block), "a finished block is valid");
+
+	struct control_config cfg;
+	struct control_config read_back;
+	control_config_from_config(&cfg, &config_defaults);
+	control_block_write_config(&block, &cfg);
+	check(control_block_read_config(&block, &read_back) && memcmp(&cfg, &read_back, sizeof(cfg)) == 0, "config reads back");
+	check(block.config_seq == 2, "a write moves the sequence by 2");
+
+	// a writer that died halfway leaves the sequence odd, readers give up instead of hanging
+	block.config_seq++;
+	check(!control_block_read_config(&block, &read_back), "readers give up on a stuck writer");
+	block.config_seq++;
+
+	uint32_t request_seq = 0;
+	check(!control_block_read_request(&block, &read_back, &request_seq), "no request before one is written");
+	fill_request(&cfg, 42);
+	check(control_block_write_request(&block, &cfg), "request written");
+	check(control_block_read_request(&block, &read_back, &request_seq) && read_back.max_framerate_auto == 42, "request read once");
+	check(!control_block_read_request(&block, &read_back, &request_seq), "the same request is not read twice");
+
+	// profile requests are names, told apart from config requests by their own sequence
+	uint32_t profile_seq = 0;
+	char profile[CONFIG_PROFILE_NAME_MAX];
+	check(!control_block_read_profile_request(&block, profile, &profile_seq), "no profile request before one is written");
+	check(control_block_write_profile_request(&block, "practice"), "profile request written");
+	check(!control_block_read_request(&block, &read_back, &request_seq), "a profile request is not a config request");
+	check(control_block_read_profile_request(&block, profile, &profile_seq) && strcmp(profile, "practice") == 0, "profile request read once");
+	check(!control_block_read_profile_request(&block, profile, &profile_seq), "the same profile request is not read twice");
+	check(!control_block_write_profile_request(&block, "a profile name longer than the block holds"), "names too long are refused");
+	check(control_block_write_profile_request(&block, "") && control_block_read_profile_request(&block, profile, &profile_seq) && profile[0] == '\0', "an empty name asks for the top level keys");
+	// a tool that skipped the helper can't make the asi read past the name
+	memset(block.profile_request, 'x', CONFIG_PROFILE_NAME_MAX);
+	block.profile_seq += 2;
+	check(control_block_read_profile_request(&block, profile, &profile_seq) && strlen(profile) == CONFIG_PROFILE_NAME_MAX - 1, "profile requests read back terminated");
+
+	stress_end_ns = now_ns() + (uint64_t)(seconds * 1000 * 1000 * 1000);
+	struct stress_counts status_counts[2] = {};
+	struct stress_counts request_counts = {};
+	pthread_t threads[6];
+	pthread_create(&threads[0], NULL, status_writer, NULL);
+	pthread_create(&threads[1], NULL, status_reader, &status_counts[0]);
+	pthread_create(&threads[2], NULL, status_reader, &status_counts[1]);
+	pthread_create(&threads[3], NULL, request_writer, (void *)(intptr_t)0);
+	pthread_create(&threads[4], NULL, request_writer, (void *)(intptr_t)1);
+	pthread_create(&threads[5], NULL, request_reader, &request_counts);
+	for(int i = 0;i < 6;i++){
+		pthread_join(threads[i], NULL);
+	}
+
+	uint64_t status_reads = status_counts[0].reads + status_counts[1].reads;
+	uint64_t status_torn = status_counts[0].torn + status_counts[1].torn;
+	printf("status: %llu reads, %llu torn, %llu given up\n", (unsigned long long)status_reads, (unsigned long long)status_torn,
+		(unsigned long long)(status_counts[0].given_up + status_counts[1].given_up));
+	printf("requests: %llu reads, %llu torn\n", (unsigned long long)request_counts.reads, (unsigned long long)request_counts.torn);
+	check(status_reads > 0 && status_torn == 0, "status reads are never torn");
+	check(request_counts.reads > 0 && request_counts.torn == 0, "racing requests are never torn");
+	check(!(block.request_seq & 1) && !(block.status_seq & 1), "sequences end even");
+}
+
+static void usage(const char *argv0){
+	printf("usage: %s [options]\n", argv0);
+	printf("  --seconds N          how long the threads race, default 1\n");
+	printf("  --verbose            log what the validation logs to stderr\n");
+}
+
+int main(int argc, char **argv){
+	double seconds = 1;
+	for(int i = 1;i < argc;i++){
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+		if(strcmp(arg, "--verbose") == 0){
+			check_log = true;
+			continue;
+		}
+		if(strcmp(arg, "--help") == 0){
+			usage(argv[0]);
+			return 0;
+		}
+		if(value == NULL){
+			fprintf(stderr, "%s needs a value\n", arg);
+			return 1;
+		}
+		if(strcmp(arg, "--seconds") == 0){
+			seconds = atof(value);
+		}else{
+			fprintf(stderr, "unknown option %s\n", arg);
+			usage(argv[0]);
+			return 1;
+		}
+		i++;
+	}
+
+	check_layout();
+	check_protocol(seconds);
+	printf("%d of %d checks passed\n", checks - failed, checks);
+	return failed != 0;
+}
@@ -0,0 +1,460 @@
+// frame pacing logic of the frame limiter, kept free of windows and game specifics
+// the dll drives it with the real clock and sleep backends, framelimiter_sim.cpp with modeled ones
+// define LOG and LOG_VERBOSE before including to get its messages
+#ifndef FRAMELIMITER_H
+#define FRAMELIMITER_H
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#ifndef LOG
+#define LOG(...)
+#endif
+#ifndef LOG_VERBOSE
+#define LOG_VERBOSE(...)
+#endif
+
+// where the frame limiter puts the wait relative to the game tick
+enum pacing_mode{
+	// the tick starts at the deadline
+	PACING_MODE_START = 0,
+	// the tick is predicted to finish at the deadline, input is sampled as late as possible
+	PACING_MODE_JUST_IN_TIME,
+	// the tick starts right after a millisecond boundary of the game's clock, whole milliseconds apart
+	PACING_MODE_GAME_CLOCK,
+	PACING_MODE_COUNT
+};
+static const char *pacing_mode_names[PACING_MODE_COUNT] = {
+	"start",
+	"just_in_time",
+	"game_clock",
+};
+
+// everything the pacing logic needs from the outside world
+struct framelimiter_env{
+	uint64_t (*now_ns)(void *user);
+	// coarse sleep, sleep_100ns is already a multiple of the settings' sleep_granularity_100ns
+	void (*sleep)(void *user, uint64_t sleep_100ns);
+	// executes this many pause instructions while spinning
+	void (*pause)(void *user, uint32_t pauses);
+	// the game's own millisecond clock, for PACING_MODE_GAME_CLOCK
+	double (*game_clock_ms)(void *user);
+	// optional, told when the final spin of a wait starts and ends
+	void (*spin_phase)(void *user, bool spinning);
+	void *user;
+};
+
+// the frame limiter settings in effect for one frame
+struct framelimiter_settings{
+	// 0 is not allowed here, don't call framelimiter_wait with the limiter off
+	uint64_t target_frametime_ns;
+	// sub nanosecond part of the target in 1/2^32 ns
+	uint32_t target_frametime_frac;
+	int pacing_mode;
+	bool full_busy_loop;
+	int busy_loop_buffer_100ns;
+	bool adaptive_busy_loop;
+	int busy_loop_budget_percent;
+	int jit_margin_100ns;
+	// which sleep is in use, the adaptive buffer starts over when it changes
+	int sleep_backend;
+	const char *sleep_backend_name;
+	// 0 means the sleep never sleeps and everything is spun
+	uint64_t sleep_granularity_100ns;
+	// the sleep is too coarse right now to be worth measuring or spinning after
+	bool coarse_only;
+};
+
+// streaming high percentile estimate of how late coarse sleeps wake up
+// a histogram that is halved every OVERSHOOT_DECAY_SAMPLES, so it follows load changes
+#define OVERSHOOT_BUCKET_NS 50000
+#define OVERSHOOT_BUCKETS 64
+#define OVERSHOOT_DECAY_SAMPLES 512
+#define OVERSHOOT_MIN_SAMPLES 32
+#define OVERSHOOT_PERCENTILE 99
+struct overshoot_estimator{
+	uint32_t buckets[OVERSHOOT_BUCKETS];
+	uint32_t count;
+	uint32_t since_decay;
+	// upper edge of the bucket holding the percentile, overflow counts as the last bucket
+	uint64_t estimate_ns;
+};
+
+static void overshoot_estimator_reset(struct overshoot_estimator *e){
+	memset(e, 0, sizeof(struct overshoot_estimator));
+}
+
+static void overshoot_estimator_add(struct overshoot_estimator *e, uint64_t overshoot_ns){
+	uint64_t bucket = overshoot_ns / OVERSHOOT_BUCKET_NS;
+	if(bucket >= OVERSHOOT_BUCKETS){
+		bucket = OVERSHOOT_BUCKETS - 1;
+	}
+	e->buckets[bucket]++;
+	e->count++;
+	e->since_decay++;
+
+	if(e->since_decay >= OVERSHOOT_DECAY_SAMPLES){
+		e->count = 0;
+		for(int i = 0;i < OVERSHOOT_BUCKETS;i++){
+			e->buckets[i] /= 2;
+			e->count += e->buckets[i];
+		}
+		e->since_decay = 0;
+	}
+
+	uint32_t allowed_above = e->count * (100 - OVERSHOOT_PERCENTILE) / 100;
+	uint32_t above = 0;
+	for(int i = OVERSHOOT_BUCKETS - 1;i >= 0;i--){
+		above += e->buckets[i];
+		if(above > allowed_above){
+			e->estimate_ns = (uint64_t)(i + 1) * OVERSHOOT_BUCKET_NS;
+			break;
+		}
+	}
+}
+
+// frame pacing against a running absolute deadline on the limiter clock
+// each frame is scheduled at previous deadline + target frametime, so wake up overshoot does not pile up as drift
+struct frame_pacer{
+	// earliest time the next frame may start, 0 when the limiter was not running last frame
+	uint64_t deadline_ns;
+	// sub nanosecond part of deadline_ns in 1/2^32 ns
+	uint32_t deadline_frac;
+	uint32_t frame_count;
+	uint32_t resync_count;
+	// how late the last wait woke up compared to when it meant to
+	uint64_t last_wake_late_ns;
+	// sleep lateness of the backend in use, for adaptive_busy_loop
+	struct overshoot_estimator overshoot;
+	int overshoot_backend;
+	uint64_t logged_busy_loop_buffer_ns;
+	// game tick duration, exponentially weighted, for PACING_MODE_JUST_IN_TIME
+	double tick_mean_ns;
+	double tick_var_ns;
+	uint32_t tick_samples;
+	// when the current tick should finish in PACING_MODE_JUST_IN_TIME, 0 otherwise
+	uint64_t frame_deadline_ns;
+	uint32_t jit_frames;
+	uint32_t jit_missed_frames;
+	// mode the deadline was computed for
+	int mode;
+	// game clock value the next frame should start at in PACING_MODE_GAME_CLOCK
+	double game_clock_target_ms;
+	uint64_t game_clock_frame_ms;
+	uint32_t game_clock_timeouts;
+	// preemptions noticed while spinning in the current wait, and the time lost to them
+	uint32_t spin_preemptions;
+	uint64_t spin_preempted_ns;
+	// summed up over SPIN_STATS_INTERVAL_FRAMES for the log
+	uint32_t spin_stats_frames;
+	uint32_t spin_stats_preempted_frames;
+	uint32_t spin_stats_preemptions;
+	uint32_t spin_stats_max_preemptions;
+	uint64_t spin_stats_preempted_ns;
+};
+
+#define TICK_EWMA_ALPHA (1.0 / 16)
+#define TICK_MIN_SAMPLES 16
+// how many standard deviations of tick duration to wake up early on top of the mean
+#define JIT_STDDEV_FACTOR 2.0
+#define JIT_STATS_INTERVAL_FRAMES 1024
+
+static uint64_t framelimiter_lead_ns(struct frame_pacer *pacer, const struct framelimiter_settings *settings){
+	if(settings->pacing_mode != PACING_MODE_JUST_IN_TIME || pacer->tick_samples < TICK_MIN_SAMPLES){
+		return 0;
+	}
+	double lead_ns = pacer->tick_mean_ns + JIT_STDDEV_FACTOR * sqrt(pacer->tick_var_ns) + settings->jit_margin_100ns * 100.0;
+	if(lead_ns < 0){
+		return 0;
+	}
+	if(lead_ns > settings->target_frametime_ns){
+		return settings->target_frametime_ns;
+	}
+	return lead_ns;
+}
+
+// call after every game tick with its start and end time
+static void framelimiter_record_tick(struct frame_pacer *pacer, uint64_t start_ns, uint64_t end_ns){
+	double duration_ns = end_ns - start_ns;
+	if(pacer->tick_samples == 0){
+		pacer->tick_mean_ns = duration_ns;
+		pacer->tick_var_ns = 0;
+	}else{
+		double diff = duration_ns - pacer->tick_mean_ns;
+		pacer->tick_mean_ns += TICK_EWMA_ALPHA * diff;
+		pacer->tick_var_ns = (1 - TICK_EWMA_ALPHA) * (pacer->tick_var_ns + TICK_EWMA_ALPHA * diff * diff);
+	}
+	if(pacer->tick_samples < TICK_MIN_SAMPLES){
+		pacer->tick_samples++;
+	}
+
+	if(pacer->frame_deadline_ns == 0){
+		return;
+	}
+	pacer->jit_frames++;
+	if(end_ns > pacer->frame_deadline_ns){
+		pacer->jit_missed_frames++;
+		LOG_VERBOSE("frame %u finished %llu ns after its deadline", pacer->frame_count, (unsigned long long)(end_ns - pacer->frame_deadline_ns));
+	}
+	pacer->frame_deadline_ns = 0;
+	if(pacer->jit_frames >= JIT_STATS_INTERVAL_FRAMES){
+		LOG("just in time pacing: tick mean %.0f ns, stddev %.0f ns, %u of %u frames finished after their deadline", pacer->tick_mean_ns, sqrt(pacer->tick_var_ns), pacer->jit_missed_frames, pacer->jit_frames);
+		pacer->jit_frames = 0;
+		pacer->jit_missed_frames = 0;
+	}
+}
+
+static uint64_t framelimiter_busy_loop_buffer_ns(struct frame_pacer *pacer, const struct framelimiter_settings *settings){
+	uint64_t buffer_ns = (uint64_t)settings->busy_loop_buffer_100ns * 100;
+	if(!settings->adaptive_busy_loop){
+		return buffer_ns;
+	}
+
+	if(pacer->overshoot_backend != settings->sleep_backend){
+		// a different backend has a different distribution, start learning again
+		overshoot_estimator_reset(&pacer->overshoot);
+		pacer->overshoot_backend = settings->sleep_backend;
+	}
+
+	// the configured buffer is the starting guess until there are enough samples
+	if(pacer->overshoot.count >= OVERSHOOT_MIN_SAMPLES){
+		buffer_ns = pacer->overshoot.estimate_ns;
+	}
+	uint64_t budget_ns = settings->target_frametime_ns * settings->busy_loop_budget_percent / 100;
+	if(buffer_ns > budget_ns){
+		buffer_ns = budget_ns;
+	}
+
+	uint64_t logged_ns = pacer->logged_busy_loop_buffer_ns;
+	if(buffer_ns > logged_ns + OVERSHOOT_BUCKET_NS || buffer_ns + OVERSHOOT_BUCKET_NS < logged_ns){
+		LOG("adaptive busy loop buffer now %llu ns, p99 sleep overshoot %llu ns over %u samples, budget %llu ns", (unsigned long long)buffer_ns, (unsigned long long)pacer->overshoot.estimate_ns, pacer->overshoot.count, (unsigned long long)budget_ns);
+		pacer->logged_busy_loop_buffer_ns = buffer_ns;
+	}
+	return buffer_ns;
+}
+
+static void framelimiter_advance_deadline(struct frame_pacer *pacer, const struct framelimiter_settings *settings){
+	uint64_t frac = (uint64_t)pacer->deadline_frac + settings->target_frametime_frac;
+	pacer->deadline_ns += settings->target_frametime_ns + (frac >> 32);
+	pacer->deadline_frac = (uint32_t)frac;
+}
+
+// pause between clock reads while spinning, backing off while the deadline is still far
+// so the smt sibling gets the core, and reading every iteration when it is close
+#define SPIN_BACKOFF_NEAR_NS 20000
+#define SPIN_BACKOFF_MAX_PAUSES 64
+
+static void framelimiter_spin_pause(const struct framelimiter_env *env, uint64_t remaining_ns, uint32_t *pauses){
+	if(remaining_ns < SPIN_BACKOFF_NEAR_NS){
+		*pauses = 1;
+	}else if(*pauses < SPIN_BACKOFF_MAX_PAUSES){
+		*pauses *= 2;
+	}
+	env->pause(env->user, *pauses);
+}
+
+// a gap this long between two clock reads of the spin loop means the thread was not running
+#define SPIN_PREEMPTION_GAP_NS 50000
+#define SPIN_STATS_INTERVAL_FRAMES 1024
+
+static void framelimiter_spin_phase(const struct framelimiter_env *env, bool *spinning, bool spin){
+	if(*spinning == spin){
+		return;
+	}
+	*spinning = spin;
+	if(env->spin_phase != NULL){
+		env->spin_phase(env->user, spin);
+	}
+}
+
+static void framelimiter_check_preemption(struct frame_pacer *pacer, uint64_t before_ns, uint64_t after_ns){
+	if(after_ns - before_ns > SPIN_PREEMPTION_GAP_NS){
+		pacer->spin_preemptions++;
+		pacer->spin_preempted_ns += after_ns - before_ns;
+	}
+}
+
+// call once per limited frame after the wait
+static void framelimiter_record_spin_stats(struct frame_pacer *pacer){
+	if(pacer->spin_preemptions != 0){
+		LOG_VERBOSE("frame %u was preempted %u times for %llu ns while spinning", pacer->frame_count, pacer->spin_preemptions, (unsigned long long)pacer->spin_preempted_ns);
+		pacer->spin_stats_preempted_frames++;
+		pacer->spin_stats_preemptions += pacer->spin_preemptions;
+		pacer->spin_stats_preempted_ns += pacer->spin_preempted_ns;
+		if(pacer->spin_preemptions > pacer->spin_stats_max_preemptions){
+			pacer->spin_stats_max_preemptions = pacer->spin_preemptions;
+		}
+	}
+	pacer->spin_stats_frames++;
+	if(pacer->spin_stats_frames >= SPIN_STATS_INTERVAL_FRAMES){
+		LOG("spin preemptions: %u of %u frames preempted, %u preemptions, at most %u in a frame, %llu ns lost", pacer->spin_stats_preempted_frames, pacer->spin_stats_frames, pacer->spin_stats_preemptions, pacer->spin_stats_max_preemptions, (unsigned long long)pacer->spin_stats_preempted_ns);
+		pacer->spin_stats_frames = 0;
+		pacer->spin_stats_preempted_frames = 0;
+		pacer->spin_stats_preemptions = 0;
+		pacer->spin_stats_max_preemptions = 0;
+		pacer->spin_stats_preempted_ns = 0;
+	}
+}
+
+// sleeps and spins until wake_ns, returns the time it woke up at
+static uint64_t framelimiter_sleep_until(struct frame_pacer *pacer, const struct framelimiter_env *env, const struct framelimiter_settings *settings, uint64_t wake_ns){
+	uint64_t now_ns = env->now_ns(env->user);
+	uint64_t granularity_100ns = settings->sleep_granularity_100ns;
+	uint64_t buffer_100ns = framelimiter_busy_loop_buffer_ns(pacer, settings) / 100;
+	if(settings->coarse_only){
+		buffer_100ns = 0;
+	}
+	uint32_t pauses = 1;
+	bool spinning = false;
+	while(now_ns < wake_ns){
+		if(settings->full_busy_loop || granularity_100ns == 0){
+			// spin it all
+		}else{
+			uint64_t remaining_100ns = (wake_ns - now_ns) / 100;
+			if(remaining_100ns > buffer_100ns){
+				uint64_t sleep_100ns = remaining_100ns - buffer_100ns;
+				// correct to multiple of the backend's granularity
+				sleep_100ns = granularity_100ns * (sleep_100ns / granularity_100ns);
+				LOG_VERBOSE("need %llu pieces of 100ns delay, corrected to %llu using %llu", (unsigned long long)(remaining_100ns - buffer_100ns), (unsigned long long)sleep_100ns, (unsigned long long)granularity_100ns);
+				if(sleep_100ns > 0){
+					LOG_VERBOSE("at frame %u time %llu using %s to delay %llu pieces of 100ns", pacer->frame_count, (unsigned long long)now_ns, settings->sleep_backend_name, (unsigned long long)sleep_100ns);
+					uint64_t sleep_end_ns = now_ns + sleep_100ns * 100;
+					framelimiter_spin_phase(env, &spinning, false);
+					env->sleep(env->user, sleep_100ns);
+					now_ns = env->now_ns(env->user);
+					if(!settings->coarse_only){
+						overshoot_estimator_add(&pacer->overshoot, now_ns > sleep_end_ns ? now_ns - sleep_end_ns : 0);
+					}
+					continue;
+				}
+			}
+			// spin the rest
+		}
+		framelimiter_spin_phase(env, &spinning, true);
+		uint64_t before_ns = now_ns;
+		framelimiter_spin_pause(env, wake_ns - now_ns, &pauses);
+		now_ns = env->now_ns(env->user);
+		framelimiter_check_preemption(pacer, before_ns, now_ns);
+	}
+	framelimiter_spin_phase(env, &spinning, false);
+	return now_ns;
+}
+
+// how long before the estimated boundary to stop sleeping and start polling the game's clock
+#define GAME_CLOCK_GUARD_NS 250000
+
+// starts frames right after the game's clock ticks over to a whole number of milliseconds since the last frame
+// so every frame sees the same delta_t, the frametime is rounded up to whole milliseconds for that
+static void framelimiter_wait_game_clock(struct frame_pacer *pacer, const struct framelimiter_env *env, const struct framelimiter_settings *settings){
+	// rounded up, a frame limiter must never run faster than its cap
+	uint64_t frame_ms = (settings->target_frametime_ns + 1000 * 1000 - 1) / (1000 * 1000);
+	if(frame_ms == 0){
+		frame_ms = 1;
+	}
+	uint64_t frame_ns = frame_ms * 1000 * 1000;
+	if(frame_ms != pacer->game_clock_frame_ms){
+		LOG("game clock pacing at %llu ms per frame, %.2f fps", (unsigned long long)frame_ms, 1000.0 / frame_ms);
+		pacer->game_clock_frame_ms = frame_ms;
+	}
+
+	if(pacer->deadline_ns == 0){
+		// first limited frame, nothing to wait for
+		pacer->game_clock_target_ms = env->game_clock_ms(env->user) + frame_ms;
+		pacer->deadline_ns = env->now_ns(env->user) + frame_ns;
+		pacer->deadline_frac = 0;
+		pacer->last_wake_late_ns = 0;
+		return;
+	}
+
+	// deadline_ns is only an estimate of when the boundary happens, the game's clock decides
+	uint64_t now_ns = framelimiter_sleep_until(pacer, env, settings, pacer->deadline_ns > GAME_CLOCK_GUARD_NS ? pacer->deadline_ns - GAME_CLOCK_GUARD_NS : 0);
+	double game_ms = env->game_clock_ms(env->user);
+	// don't hang if the game's clock stops moving
+	uint64_t give_up_ns = pacer->deadline_ns + frame_ns;
+	uint32_t pauses = 1;
+	bool spinning = false;
+	while(game_ms < pacer->game_clock_target_ms && now_ns < give_up_ns){
+		framelimiter_spin_phase(env, &spinning, true);
+		uint64_t before_ns = now_ns;
+		framelimiter_spin_pause(env, 0, &pauses);
+		game_ms = env->game_clock_ms(env->user);
+		now_ns = env->now_ns(env->user);
+		framelimiter_check_preemption(pacer, before_ns, now_ns);
+	}
+	framelimiter_spin_phase(env, &spinning, false);
+
+	double late_ms = game_ms - pacer->game_clock_target_ms;
+	pacer->last_wake_late_ns = late_ms > 0 ? late_ms * 1000 * 1000 : 0;
+	if(late_ms < 0){
+		LOG_VERBOSE("game clock at %f did not reach %f in time", game_ms, pacer->game_clock_target_ms);
+		pacer->game_clock_timeouts++;
+		late_ms = 0;
+		pacer->game_clock_target_ms = game_ms;
+		pacer->resync_count++;
+	}else if(late_ms >= frame_ms){
+		// stalled for more than a frame, don't burst frames to catch up
+		LOG_VERBOSE("resyncing game clock target after being %f ms late", late_ms);
+		late_ms = 0;
+		pacer->game_clock_target_ms = game_ms;
+		pacer->resync_count++;
+	}
+	pacer->game_clock_target_ms += frame_ms;
+	pacer->deadline_ns = now_ns + frame_ns - (uint64_t)(late_ms * 1000 * 1000);
+	framelimiter_record_spin_stats(pacer);
+	pacer->frame_count++;
+}
+
+// waits for the next frame, call right before the game tick while the frame limiter is on
+static void framelimiter_wait(struct frame_pacer *pacer, const struct framelimiter_env *env, const struct framelimiter_settings *settings){
+	if(pacer->mode != settings->pacing_mode){
+		// deadlines mean something else in the other modes, start over
+		pacer->deadline_ns = 0;
+		pacer->mode = settings->pacing_mode;
+	}
+	pacer->spin_preemptions = 0;
+	pacer->spin_preempted_ns = 0;
+
+	if(pacer->mode == PACING_MODE_GAME_CLOCK){
+		framelimiter_wait_game_clock(pacer, env, settings);
+		return;
+	}
+
+	if(pacer->deadline_ns == 0){
+		// first limited frame, nothing to wait for
+		pacer->deadline_ns = env->now_ns(env->user);
+		pacer->deadline_frac = 0;
+		pacer->last_wake_late_ns = 0;
+		framelimiter_advance_deadline(pacer, settings);
+		return;
+	}
+
+	// start mode wakes at the deadline, just in time mode early enough for the tick to end at it
+	uint64_t lead_ns = framelimiter_lead_ns(pacer, settings);
+	uint64_t wake_ns = pacer->deadline_ns - lead_ns;
+	uint64_t now_ns = framelimiter_sleep_until(pacer, env, settings, wake_ns);
+
+	uint64_t late_ns = now_ns - wake_ns;
+	pacer->last_wake_late_ns = late_ns;
+	LOG_VERBOSE("frame %u woke %llu ns after wake up time, %llu ns lead", pacer->frame_count, (unsigned long long)late_ns, (unsigned long long)lead_ns);
+	if(late_ns > settings->target_frametime_ns){
+		// stalled for more than a frame (loading, alt-tab, debugger), don't burst frames to catch up
+		LOG_VERBOSE("resyncing frame deadline after being %llu ns late", (unsigned long long)late_ns);
+		pacer->deadline_ns = now_ns + lead_ns;
+		pacer->deadline_frac = 0;
+		pacer->resync_count++;
+	}
+	if(pacer->mode == PACING_MODE_JUST_IN_TIME){
+		pacer->frame_deadline_ns = pacer->deadline_ns;
+	}
+	framelimiter_advance_deadline(pacer, settings);
+	framelimiter_record_spin_stats(pacer);
+	pacer->frame_count++;
+}
+
+// the limiter is off this frame, the next limited frame starts over instead of catching up
+static void framelimiter_reset(struct frame_pacer *pacer){
+	pacer->deadline_ns = 0;
+}
+
+#endif // FRAMELIMITER_H
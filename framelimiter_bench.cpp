@@ -0,0 +1,348 @@
+// real time benchmark of the frame limiter in framelimiter.h on the linux build host
+// runs the production pacing logic against a synthetic game tick for a while per configuration and writes a json report
+// build with build_tools.sh, run with --help for options
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+static bool bench_log = false;
+#define LOG(...) \
+{ \
+	if(bench_log){ \
+		fprintf(stderr, __VA_ARGS__); \
+		fputc('\n', stderr); \
+	} \
+}
+
+#include "framelimiter_linux.h"
+
+// wake up lateness histogram, LATENESS_BUCKET_NS wide buckets, the last one collects everything above
+#define LATENESS_BUCKET_NS 10000
+#define LATENESS_BUCKETS 101
+
+// splitmix64, so every configuration sees the same tick costs
+static uint64_t rng_next(uint64_t *state){
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+static double rng_normal(uint64_t *state){
+	double u1 = (rng_next(state) >> 11) * (1.0 / 9007199254740992.0);
+	double u2 = (rng_next(state) >> 11) * (1.0 / 9007199254740992.0);
+	return sqrt(-2 * log(1 - u1)) * cos(2 * M_PI * u2);
+}
+
+// burns cpu like a game tick would until duration_ns has passed
+static volatile uint64_t workload_sink;
+static void synthetic_tick(uint64_t duration_ns){
+	uint64_t end_ns = linux_now_ns(NULL) + duration_ns;
+	uint64_t x = workload_sink;
+	while(linux_now_ns(NULL) < end_ns){
+		for(int i = 0;i < 64;i++){
+			x = x * 6364136223846793005ull + 1442695040888963407ull;
+		}
+	}
+	workload_sink = x;
+}
+
+struct bench_config{
+	double fps;
+	int sleep_backend;
+	int pacing_mode;
+	bool adaptive_busy_loop;
+	int busy_loop_buffer_100ns;
+};
+
+struct bench_result{
+	uint32_t frames;
+	std::vector<uint64_t> frametimes_ns;
+	uint32_t lateness[LATENESS_BUCKETS];
+	uint64_t lateness_max_ns;
+	uint64_t wall_ns;
+	uint64_t cpu_ns;
+	uint64_t wait_cpu_ns;
+	uint32_t resyncs;
+	// preemptions the pacer noticed while spinning, and in how many frames
+	uint32_t preemptions;
+	uint32_t preempted_frames;
+	uint64_t preempted_ns;
+};
+
+static void run(const struct bench_config *config, double seconds, uint64_t tick_mean_ns, uint64_t tick_jitter_ns, uint64_t seed, struct bench_result *result){
+	double frametime_ns = 1000.0 * 1000 * 1000 / config->fps;
+	struct framelimiter_settings settings = {
+		.target_frametime_ns = (uint64_t)frametime_ns,
+		.target_frametime_frac = (uint32_t)((frametime_ns - floor(frametime_ns)) * 4294967296.0),
+		.pacing_mode = config->pacing_mode,
+		.full_busy_loop = false,
+		.busy_loop_buffer_100ns = config->busy_loop_buffer_100ns,
+		.adaptive_busy_loop = config->adaptive_busy_loop,
+		.busy_loop_budget_percent = 50,
+		.jit_margin_100ns = 5000,
+		.sleep_backend = config->sleep_backend,
+		.sleep_backend_name = linux_sleep_backend_names[config->sleep_backend],
+		.sleep_granularity_100ns = linux_sleep_backend_granularity_100ns[config->sleep_backend],
+		.coarse_only = false,
+	};
+
+	struct frame_pacer pacer = {0};
+	memset(result->lateness, 0, sizeof(result->lateness));
+	result->lateness_max_ns = 0;
+	result->wait_cpu_ns = 0;
+	result->preemptions = 0;
+	result->preempted_frames = 0;
+	result->preempted_ns = 0;
+	result->frametimes_ns.clear();
+	result->frametimes_ns.reserve(seconds * config->fps * 1.1 + 16);
+
+	uint64_t rng = seed;
+	uint64_t duration_ns = seconds * 1000 * 1000 * 1000;
+	uint64_t cpu_start_ns = linux_thread_cpu_ns();
+	uint64_t start_ns = linux_now_ns(NULL);
+	uint64_t last_tick_start_ns = 0;
+	uint32_t frame = 0;
+	while(linux_now_ns(NULL) - start_ns < duration_ns){
+		uint64_t wait_cpu_start_ns = linux_thread_cpu_ns();
+		framelimiter_wait(&pacer, &linux_framelimiter_env, &settings);
+		result->wait_cpu_ns += linux_thread_cpu_ns() - wait_cpu_start_ns;
+		if(pacer.spin_preemptions != 0){
+			result->preemptions += pacer.spin_preemptions;
+			result->preempted_frames++;
+			result->preempted_ns += pacer.spin_preempted_ns;
+		}
+
+		uint64_t tick_start_ns = linux_now_ns(NULL);
+		if(frame != 0){
+			uint64_t bucket = pacer.last_wake_late_ns / LATENESS_BUCKET_NS;
+			result->lateness[bucket < LATENESS_BUCKETS ? bucket : LATENESS_BUCKETS - 1]++;
+			if(pacer.last_wake_late_ns > result->lateness_max_ns){
+				result->lateness_max_ns = pacer.last_wake_late_ns;
+			}
+			result->frametimes_ns.push_back(tick_start_ns - last_tick_start_ns);
+		}
+		last_tick_start_ns = tick_start_ns;
+
+		double tick_ns = tick_mean_ns + tick_jitter_ns * rng_normal(&rng);
+		synthetic_tick(tick_ns > 0 ? tick_ns : 0);
+		framelimiter_record_tick(&pacer, tick_start_ns, linux_now_ns(NULL));
+		frame++;
+	}
+	result->wall_ns = linux_now_ns(NULL) - start_ns;
+	result->cpu_ns = linux_thread_cpu_ns() - cpu_start_ns;
+	result->frames = frame;
+	result->resyncs = pacer.resync_count;
+}
+
+static uint64_t percentile(const std::vector<uint64_t> &sorted, double p){
+	if(sorted.empty()){
+		return 0;
+	}
+	size_t index = sorted.size() * p;
+	if(index >= sorted.size()){
+		index = sorted.size() - 1;
+	}
+	return sorted[index];
+}
+
+static void write_result(FILE *out, const struct bench_config *config, struct bench_result *result, bool last){
+	std::vector<uint64_t> &ft = result->frametimes_ns;
+	double mean_ns = 0;
+	for(uint64_t x : ft){
+		mean_ns += x;
+	}
+	mean_ns = ft.empty() ? 0 : mean_ns / ft.size();
+	double var = 0;
+	for(uint64_t x : ft){
+		var += (x - mean_ns) * (x - mean_ns);
+	}
+	double stddev_ns = ft.empty() ? 0 : sqrt(var / ft.size());
+	std::sort(ft.begin(), ft.end());
+
+	fprintf(out, "\t\t{\n");
+	fprintf(out, "\t\t\t\"fps\": %.3f,\n", config->fps);
+	fprintf(out, "\t\t\t\"sleep_backend\": \"%s\",\n", linux_sleep_backend_names[config->sleep_backend]);
+	fprintf(out, "\t\t\t\"pacing_mode\": \"%s\",\n", pacing_mode_names[config->pacing_mode]);
+	fprintf(out, "\t\t\t\"adaptive_busy_loop\": %s,\n", config->adaptive_busy_loop ? "true" : "false");
+	fprintf(out, "\t\t\t\"busy_loop_buffer_100ns\": %d,\n", config->busy_loop_buffer_100ns);
+	fprintf(out, "\t\t\t\"frames\": %u,\n", result->frames);
+	fprintf(out, "\t\t\t\"resyncs\": %u,\n", result->resyncs);
+	fprintf(out, "\t\t\t\"spin_preemptions\": {\"count\": %u, \"frames\": %u, \"lost_ns\": %llu},\n", result->preemptions, result->preempted_frames, (unsigned long long)result->preempted_ns);
+	fprintf(out, "\t\t\t\"frametime_ns\": {\"mean\": %.1f, \"stddev\": %.1f, \"min\": %llu, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p99_9\": %llu, \"max\": %llu},\n",
+		mean_ns, stddev_ns, (unsigned long long)percentile(ft, 0), (unsigned long long)percentile(ft, 0.5), (unsigned long long)percentile(ft, 0.9),
+		(unsigned long long)percentile(ft, 0.99), (unsigned long long)percentile(ft, 0.999), (unsigned long long)(ft.empty() ? 0 : ft.back()));
+	fprintf(out, "\t\t\t\"wake_lateness\": {\"bucket_ns\": %d, \"max_ns\": %llu, \"counts\": [", LATENESS_BUCKET_NS, (unsigned long long)result->lateness_max_ns);
+	// trailing empty buckets carry nothing
+	int used = LATENESS_BUCKETS;
+	while(used > 0 && result->lateness[used - 1] == 0){
+		used--;
+	}
+	for(int i = 0;i < used;i++){
+		fprintf(out, "%s%u", i == 0 ? "" : ", ", result->lateness[i]);
+	}
+	fprintf(out, "]},\n");
+	fprintf(out, "\t\t\t\"cpu\": {\"wall_ns\": %llu, \"thread_cpu_ns\": %llu, \"wait_cpu_ns\": %llu, \"wait_cpu_per_frame_ns\": %.1f}\n",
+		(unsigned long long)result->wall_ns, (unsigned long long)result->cpu_ns, (unsigned long long)result->wait_cpu_ns,
+		result->frames == 0 ? 0.0 : (double)result->wait_cpu_ns / result->frames);
+	fprintf(out, "\t\t}%s\n", last ? "" : ",");
+}
+
+static int find_name(const char *name, const char *const *names, int count){
+	for(int i = 0;i < count;i++){
+		if(strcmp(name, names[i]) == 0){
+			return i;
+		}
+	}
+	return -1;
+}
+
+static void usage(const char *argv0){
+	printf("usage: %s [options]\n", argv0);
+	printf("  --fps N              target framerate, repeatable, default 144 and 300\n");
+	printf("  --seconds N          seconds per configuration, default 5\n");
+	printf("  --backend NAME       only this sleep backend, nanosleep or spin\n");
+	printf("  --mode NAME          only this pacing mode, start, just_in_time or game_clock\n");
+	printf("  --buffer-100ns N     fixed busy loop buffer, default 15000\n");
+	printf("  --tick-mean-us N     synthetic tick cost mean, default 1500\n");
+	printf("  --tick-jitter-us N   synthetic tick cost standard deviation, default 300\n");
+	printf("  --seed N             default 1\n");
+	printf("  --label TEXT         written to the report, eg. the revision being measured\n");
+	printf("  --out FILE           write the report here instead of stdout\n");
+	printf("  --verbose            log what the pacer logs to stderr\n");
+}
+
+int main(int argc, char **argv){
+	std::vector<double> fps_list;
+	double seconds = 5;
+	int only_backend = -1;
+	int only_mode = -1;
+	int buffer_100ns = 15000;
+	uint64_t tick_mean_ns = 1500000;
+	uint64_t tick_jitter_ns = 300000;
+	uint64_t seed = 1;
+	const char *label = "";
+	const char *out_path = NULL;
+
+	for(int i = 1;i < argc;i++){
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+		if(strcmp(arg, "--verbose") == 0){
+			bench_log = true;
+			continue;
+		}
+		if(strcmp(arg, "--help") == 0){
+			usage(argv[0]);
+			return 0;
+		}
+		if(value == NULL){
+			fprintf(stderr, "%s needs a value\n", arg);
+			return 1;
+		}
+		if(strcmp(arg, "--fps") == 0){
+			fps_list.push_back(atof(value));
+		}else if(strcmp(arg, "--seconds") == 0){
+			seconds = atof(value);
+		}else if(strcmp(arg, "--backend") == 0){
+			only_backend = find_name(value, linux_sleep_backend_names, LINUX_SLEEP_BACKEND_COUNT);
+			if(only_backend < 0){
+				fprintf(stderr, "unknown backend %s\n", value);
+				return 1;
+			}
+		}else if(strcmp(arg, "--mode") == 0){
+			only_mode = find_name(value, pacing_mode_names, PACING_MODE_COUNT);
+			if(only_mode < 0){
+				fprintf(stderr, "unknown pacing mode %s\n", value);
+				return 1;
+			}
+		}else if(strcmp(arg, "--buffer-100ns") == 0){
+			buffer_100ns = atoi(value);
+		}else if(strcmp(arg, "--tick-mean-us") == 0){
+			tick_mean_ns = atof(value) * 1000;
+		}else if(strcmp(arg, "--tick-jitter-us") == 0){
+			tick_jitter_ns = atof(value) * 1000;
+		}else if(strcmp(arg, "--seed") == 0){
+			seed = strtoull(value, NULL, 10);
+		}else if(strcmp(arg, "--label") == 0){
+			label = value;
+		}else if(strcmp(arg, "--out") == 0){
+			out_path = value;
+		}else{
+			fprintf(stderr, "unknown option %s\n", arg);
+			usage(argv[0]);
+			return 1;
+		}
+		i++;
+	}
+	if(fps_list.empty()){
+		fps_list.push_back(144);
+		fps_list.push_back(300);
+	}
+	for(double fps : fps_list){
+		if(!(fps > 0)){
+			fprintf(stderr, "fps has to be above 0\n");
+			return 1;
+		}
+	}
+
+	std::vector<struct bench_config> configs;
+	for(double fps : fps_list){
+		for(int backend = 0;backend < LINUX_SLEEP_BACKEND_COUNT;backend++){
+			if(only_backend >= 0 && backend != only_backend){
+				continue;
+			}
+			for(int mode = 0;mode < PACING_MODE_COUNT;mode++){
+				if(only_mode >= 0 && mode != only_mode){
+					continue;
+				}
+				configs.push_back({fps, backend, mode, false, buffer_100ns});
+				if(linux_sleep_backend_granularity_100ns[backend] != 0){
+					configs.push_back({fps, backend, mode, true, buffer_100ns});
+				}
+			}
+		}
+	}
+
+	FILE *out = stdout;
+	if(out_path != NULL){
+		out = fopen(out_path, "w");
+		if(out == NULL){
+			fprintf(stderr, "failed opening %s for writing\n", out_path);
+			return 1;
+		}
+	}
+
+	std::string escaped_label;
+	for(const char *c = label;*c != '\0';c++){
+		if(*c == '"' || *c == '\\'){
+			escaped_label += '\\';
+		}
+		escaped_label += *c;
+	}
+	fprintf(out, "{\n");
+	fprintf(out, "\t\"label\": \"%s\",\n", escaped_label.c_str());
+	fprintf(out, "\t\"seconds_per_config\": %.3f,\n", seconds);
+	fprintf(out, "\t\"tick_mean_ns\": %llu,\n", (unsigned long long)tick_mean_ns);
+	fprintf(out, "\t\"tick_jitter_ns\": %llu,\n", (unsigned long long)tick_jitter_ns);
+	fprintf(out, "\t\"results\": [\n");
+	struct bench_result result;
+	for(size_t i = 0;i < configs.size();i++){
+		const struct bench_config *config = &configs[i];
+		fprintf(stderr, "%.2f fps, %s, %s, %s buffer\n", config->fps, linux_sleep_backend_names[config->sleep_backend], pacing_mode_names[config->pacing_mode], config->adaptive_busy_loop ? "adaptive" : "fixed");
+		run(config, seconds, tick_mean_ns, tick_jitter_ns, seed, &result);
+		write_result(out, config, &result, i + 1 == configs.size());
+		fflush(out);
+	}
+	fprintf(out, "\t]\n");
+	fprintf(out, "}\n");
+	if(out != stdout){
+		fclose(out);
+	}
+	return 0;
+}
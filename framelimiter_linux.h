@@ -0,0 +1,73 @@
+// linux implementation of the frame limiter's platform calls, the windows one is in s4_league_fps_unlock.cpp
+// used by the host tools to run the production pacing logic against real timers
+#ifndef FRAMELIMITER_LINUX_H
+#define FRAMELIMITER_LINUX_H
+
+#include <time.h>
+#include <cerrno>
+
+#include "framelimiter.h"
+
+enum linux_sleep_backend_id{
+	LINUX_SLEEP_BACKEND_NANOSLEEP = 0,
+	LINUX_SLEEP_BACKEND_SPIN,
+	LINUX_SLEEP_BACKEND_COUNT
+};
+static const char *linux_sleep_backend_names[LINUX_SLEEP_BACKEND_COUNT] = {
+	"nanosleep",
+	"spin",
+};
+// what each backend reports as granularity, clock_nanosleep takes nanoseconds
+static const uint64_t linux_sleep_backend_granularity_100ns[LINUX_SLEEP_BACKEND_COUNT] = {
+	1,
+	0,
+};
+
+// raw so ntp slewing doesn't bend the measured frametimes
+static uint64_t linux_now_ns(void *user){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+// clock_nanosleep can't sleep on CLOCK_MONOTONIC_RAW, relative sleeps on CLOCK_MONOTONIC only differ by the slew
+static void linux_sleep(void *user, uint64_t sleep_100ns){
+	uint64_t sleep_ns = sleep_100ns * 100;
+	struct timespec ts;
+	ts.tv_sec = sleep_ns / (1000 * 1000 * 1000);
+	ts.tv_nsec = sleep_ns % (1000 * 1000 * 1000);
+	while(clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR){
+	}
+}
+
+static void linux_pause(void *user, uint32_t pauses){
+	for(uint32_t i = 0;i < pauses;i++){
+		#if defined(__i386__) || defined(__x86_64__)
+		__builtin_ia32_pause();
+		#elif defined(__aarch64__)
+		asm volatile("yield");
+		#endif
+	}
+}
+
+// stands in for the game's millisecond clock
+static double linux_game_clock_ms(void *user){
+	return (double)(linux_now_ns(user) / (1000 * 1000));
+}
+
+static const struct framelimiter_env linux_framelimiter_env = {
+	.now_ns = linux_now_ns,
+	.sleep = linux_sleep,
+	.pause = linux_pause,
+	.game_clock_ms = linux_game_clock_ms,
+	.user = NULL,
+};
+
+// cpu time of the calling thread
+static uint64_t linux_thread_cpu_ns(){
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+#endif // FRAMELIMITER_LINUX_H
@@ -0,0 +1,463 @@
+// deterministic simulator for the frame limiter in framelimiter.h
+// runs the pacing logic on a virtual clock with modeled sleep backends, background load and game tick costs
+// build with build_tools.sh, run with --help for options
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+static bool sim_log = false;
+#define LOG(...) \
+{ \
+	if(sim_log){ \
+		fprintf(stderr, __VA_ARGS__); \
+		fputc('\n', stderr); \
+	} \
+}
+
+#include "framelimiter.h"
+
+// costs of the things the pacer does on a real cpu, the virtual clock advances by these
+#define SIM_CLOCK_READ_NS 25
+#define SIM_PAUSE_NS 35
+// a wake up this much after the planned time counts as a missed deadline
+#define SIM_MISS_NS 100000
+
+// splitmix64, the same sequence on every host and compiler
+struct sim_rng{
+	uint64_t state;
+};
+
+static uint64_t rng_next(struct sim_rng *rng){
+	uint64_t z = (rng->state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+// uniform in [0, 1)
+static double rng_uniform(struct sim_rng *rng){
+	return (rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double rng_exponential(struct sim_rng *rng, double mean){
+	return -mean * log(1 - rng_uniform(rng));
+}
+
+static double rng_normal(struct sim_rng *rng){
+	// box muller, the second value is thrown away to keep the sequence simple
+	double u1 = rng_uniform(rng);
+	double u2 = rng_uniform(rng);
+	return sqrt(-2 * log(1 - u1)) * cos(2 * M_PI * u2);
+}
+
+// how a sleep backend wakes up, with the timer resolution raised
+struct sleep_model{
+	const char *name;
+	// what the dll's backend reports as granularity
+	uint64_t granularity_100ns;
+	// wake ups happen on the first timer tick after the requested time, 0 for tickless timers
+	uint64_t tick_ns;
+	// fixed and exponentially distributed latency on top, from the interrupt to the thread running again
+	uint64_t latency_ns;
+	uint64_t latency_mean_ns;
+};
+
+// roughly what calibrate_sleep_backends logs on windows 10 and 11 machines
+static const struct sleep_model sleep_models[] = {
+	{.name = "nt_delay", .granularity_100ns = 5000, .tick_ns = 500000, .latency_ns = 5000, .latency_mean_ns = 20000},
+	{.name = "waitable_timer", .granularity_100ns = 1, .tick_ns = 0, .latency_ns = 20000, .latency_mean_ns = 60000},
+	{.name = "sleep", .granularity_100ns = 10000, .tick_ns = 1000000, .latency_ns = 5000, .latency_mean_ns = 20000},
+	{.name = "spin", .granularity_100ns = 0, .tick_ns = 0, .latency_ns = 0, .latency_mean_ns = 0},
+};
+#define SLEEP_MODEL_COUNT (int)(sizeof(sleep_models) / sizeof(sleep_models[0]))
+
+// other processes competing for the core in periodic bursts
+struct load_model{
+	const char *name;
+	// a burst of burst_ns starts every period_ns, 0 for no bursts
+	uint64_t period_ns;
+	uint64_t burst_ns;
+	// chance that a wake up during a burst waits for another thread, and for how long on average
+	double wake_delay_chance;
+	uint64_t wake_delay_mean_ns;
+	// spinning during a burst gets preempted every preempt_interval_ns on average, for preempt_mean_ns on average
+	uint64_t preempt_interval_ns;
+	uint64_t preempt_mean_ns;
+};
+
+static const struct load_model load_models[] = {
+	{.name = "none"},
+	{.name = "light", .period_ns = 1000000000, .burst_ns = 100000000, .wake_delay_chance = 0.5, .wake_delay_mean_ns = 200000, .preempt_interval_ns = 20000000, .preempt_mean_ns = 300000},
+	{.name = "heavy", .period_ns = 250000000, .burst_ns = 100000000, .wake_delay_chance = 0.8, .wake_delay_mean_ns = 1000000, .preempt_interval_ns = 5000000, .preempt_mean_ns = 1000000},
+};
+#define LOAD_MODEL_COUNT (int)(sizeof(load_models) / sizeof(load_models[0]))
+
+// game tick cost, either generated or replayed from a trace
+struct tick_model{
+	uint64_t mean_ns;
+	uint64_t jitter_ns;
+	// a spike of spike_ns every spike_interval frames, 0 for none
+	uint32_t spike_interval;
+	uint64_t spike_ns;
+	// replayed in a loop when not empty
+	std::vector<uint64_t> trace_ns;
+};
+
+struct sim{
+	uint64_t now_ns;
+	struct sim_rng rng;
+	const struct sleep_model *sleep;
+	const struct load_model *load;
+	// spin time of the current frame
+	uint64_t spin_ns;
+};
+
+static bool sim_in_burst(struct sim *sim){
+	const struct load_model *load = sim->load;
+	return load->period_ns != 0 && sim->now_ns % load->period_ns < load->burst_ns;
+}
+
+// the time a spinning thread loses to preemption while advancing by ns
+static void sim_spin(struct sim *sim, uint64_t ns){
+	sim->now_ns += ns;
+	sim->spin_ns += ns;
+	if(sim_in_burst(sim) && rng_uniform(&sim->rng) < (double)ns / sim->load->preempt_interval_ns){
+		sim->now_ns += rng_exponential(&sim->rng, sim->load->preempt_mean_ns);
+	}
+}
+
+static uint64_t sim_now_ns(void *user){
+	struct sim *sim = (struct sim *)user;
+	sim_spin(sim, SIM_CLOCK_READ_NS);
+	return sim->now_ns;
+}
+
+static void sim_sleep(void *user, uint64_t sleep_100ns){
+	struct sim *sim = (struct sim *)user;
+	const struct sleep_model *model = sim->sleep;
+	uint64_t wake_ns = sim->now_ns + sleep_100ns * 100;
+	if(model->tick_ns != 0){
+		wake_ns = (wake_ns + model->tick_ns - 1) / model->tick_ns * model->tick_ns;
+	}
+	wake_ns += model->latency_ns + (uint64_t)rng_exponential(&sim->rng, model->latency_mean_ns);
+	sim->now_ns = wake_ns;
+	if(sim_in_burst(sim) && rng_uniform(&sim->rng) < sim->load->wake_delay_chance){
+		sim->now_ns += rng_exponential(&sim->rng, sim->load->wake_delay_mean_ns);
+	}
+}
+
+static void sim_pause(void *user, uint32_t pauses){
+	sim_spin((struct sim *)user, (uint64_t)pauses * SIM_PAUSE_NS);
+}
+
+// the game's clock counts whole milliseconds
+static double sim_game_clock_ms(void *user){
+	struct sim *sim = (struct sim *)user;
+	sim_spin(sim, SIM_CLOCK_READ_NS);
+	return (double)(sim->now_ns / (1000 * 1000));
+}
+
+static uint64_t tick_cost_ns(struct sim *sim, const struct tick_model *ticks, uint32_t frame){
+	if(!ticks->trace_ns.empty()){
+		return ticks->trace_ns[frame % ticks->trace_ns.size()];
+	}
+	double cost_ns = ticks->mean_ns + ticks->jitter_ns * rng_normal(&sim->rng);
+	if(ticks->spike_interval != 0 && frame % ticks->spike_interval == ticks->spike_interval - 1){
+		cost_ns += ticks->spike_ns;
+	}
+	return cost_ns < 0 ? 0 : cost_ns;
+}
+
+struct strategy{
+	int sleep_model;
+	int pacing_mode;
+	bool adaptive_busy_loop;
+	bool full_busy_loop;
+};
+
+struct result{
+	uint32_t frames;
+	double mean_ns;
+	double stddev_ns;
+	uint64_t p99_ns;
+	uint64_t p999_ns;
+	uint32_t missed;
+	double spin_per_frame_ns;
+	// preemptions the pacer noticed while spinning
+	uint32_t preemptions;
+};
+
+static uint64_t percentile(std::vector<uint64_t> &sorted, double p){
+	size_t index = sorted.size() * p;
+	if(index >= sorted.size()){
+		index = sorted.size() - 1;
+	}
+	return sorted[index];
+}
+
+static struct result run(const struct strategy *strategy, double fps, const struct load_model *load, const struct tick_model *ticks, uint64_t duration_ns, uint64_t seed){
+	struct sim sim = {0};
+	sim.rng.state = seed;
+	sim.sleep = &sleep_models[strategy->sleep_model];
+	sim.load = load;
+	// don't start in phase with the timer ticks and bursts
+	sim.now_ns = 1000 * 1000 * 1000 + 123457;
+	uint64_t start_ns = sim.now_ns;
+
+	struct framelimiter_env env = {
+		.now_ns = sim_now_ns,
+		.sleep = sim_sleep,
+		.pause = sim_pause,
+		.game_clock_ms = sim_game_clock_ms,
+		.user = &sim,
+	};
+
+	double frametime_ns = 1000.0 * 1000 * 1000 / fps;
+	struct framelimiter_settings settings = {
+		.target_frametime_ns = (uint64_t)frametime_ns,
+		.target_frametime_frac = (uint32_t)((frametime_ns - floor(frametime_ns)) * 4294967296.0),
+		.pacing_mode = strategy->pacing_mode,
+		.full_busy_loop = strategy->full_busy_loop,
+		.busy_loop_buffer_100ns = 15000,
+		.adaptive_busy_loop = strategy->adaptive_busy_loop,
+		.busy_loop_budget_percent = 50,
+		.jit_margin_100ns = 5000,
+		.sleep_backend = strategy->sleep_model,
+		.sleep_backend_name = sim.sleep->name,
+		.sleep_granularity_100ns = sim.sleep->granularity_100ns,
+		.coarse_only = false,
+	};
+
+	struct frame_pacer pacer = {0};
+	std::vector<uint64_t> frametimes;
+	uint64_t last_start_ns = 0;
+	uint64_t spin_total_ns = 0;
+	uint32_t missed = 0;
+	uint32_t preemptions = 0;
+	uint32_t frame = 0;
+	while(sim.now_ns - start_ns < duration_ns){
+		sim.spin_ns = 0;
+		framelimiter_wait(&pacer, &env, &settings);
+		spin_total_ns += sim.spin_ns;
+		preemptions += pacer.spin_preemptions;
+		uint64_t tick_start_ns = sim.now_ns;
+		if(pacer.last_wake_late_ns > SIM_MISS_NS){
+			missed++;
+		}
+		if(last_start_ns != 0){
+			frametimes.push_back(tick_start_ns - last_start_ns);
+		}
+		last_start_ns = tick_start_ns;
+
+		sim.now_ns += tick_cost_ns(&sim, ticks, frame);
+		framelimiter_record_tick(&pacer, tick_start_ns, sim.now_ns);
+		frame++;
+	}
+
+	struct result result = {0};
+	result.frames = frame;
+	if(frametimes.empty()){
+		return result;
+	}
+	double sum = 0;
+	for(uint64_t ft : frametimes){
+		sum += ft;
+	}
+	result.mean_ns = sum / frametimes.size();
+	double var = 0;
+	for(uint64_t ft : frametimes){
+		var += (ft - result.mean_ns) * (ft - result.mean_ns);
+	}
+	result.stddev_ns = sqrt(var / frametimes.size());
+	std::sort(frametimes.begin(), frametimes.end());
+	result.p99_ns = percentile(frametimes, 0.99);
+	result.p999_ns = percentile(frametimes, 0.999);
+	result.missed = missed;
+	result.spin_per_frame_ns = (double)spin_total_ns / frame;
+	result.preemptions = preemptions;
+	return result;
+}
+
+static bool read_trace(const char *path, std::vector<uint64_t> *trace_ns){
+	FILE *f = fopen(path, "r");
+	if(f == NULL){
+		fprintf(stderr, "failed opening %s\n", path);
+		return false;
+	}
+	// one tick cost in microseconds per line
+	double us;
+	while(fscanf(f, "%lf", &us) == 1){
+		trace_ns->push_back(us * 1000);
+	}
+	fclose(f);
+	if(trace_ns->empty()){
+		fprintf(stderr, "no tick costs in %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+static int find_name(const char *name, const char *const *names, int count){
+	for(int i = 0;i < count;i++){
+		if(strcmp(name, names[i]) == 0){
+			return i;
+		}
+	}
+	return -1;
+}
+
+static void usage(const char *argv0){
+	printf("usage: %s [options]\n", argv0);
+	printf("  --fps N              target framerate, repeatable, default 144 and 300\n");
+	printf("  --seconds N          simulated seconds per run, default 20\n");
+	printf("  --load NAME          background load, none, light or heavy, default light\n");
+	printf("  --backend NAME       only this sleep backend, nt_delay, waitable_timer, sleep or spin\n");
+	printf("  --mode NAME          only this pacing mode, start, just_in_time or game_clock\n");
+	printf("  --tick-mean-us N     generated tick cost mean, default 1500\n");
+	printf("  --tick-jitter-us N   generated tick cost standard deviation, default 300\n");
+	printf("  --tick-spike-us N    extra tick cost every --tick-spike-every frames, default 8000\n");
+	printf("  --tick-spike-every N default 500, 0 for no spikes\n");
+	printf("  --ticks FILE         replay tick costs in microseconds, one per line, instead of generating them\n");
+	printf("  --seed N             default 1\n");
+	printf("  --csv                csv instead of a table\n");
+	printf("  --verbose            log what the pacer logs to stderr\n");
+}
+
+int main(int argc, char **argv){
+	std::vector<double> fps_list;
+	double seconds = 20;
+	const struct load_model *load = &load_models[1];
+	int only_backend = -1;
+	int only_mode = -1;
+	struct tick_model ticks = {.mean_ns = 1500000, .jitter_ns = 300000, .spike_interval = 500, .spike_ns = 8000000};
+	uint64_t seed = 1;
+	bool csv = false;
+
+	const char *sleep_model_names[SLEEP_MODEL_COUNT];
+	for(int i = 0;i < SLEEP_MODEL_COUNT;i++){
+		sleep_model_names[i] = sleep_models[i].name;
+	}
+	const char *load_model_names[LOAD_MODEL_COUNT];
+	for(int i = 0;i < LOAD_MODEL_COUNT;i++){
+		load_model_names[i] = load_models[i].name;
+	}
+
+	for(int i = 1;i < argc;i++){
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+		bool takes_value = true;
+		if(strcmp(arg, "--csv") == 0){
+			csv = true;
+			takes_value = false;
+		}else if(strcmp(arg, "--verbose") == 0){
+			sim_log = true;
+			takes_value = false;
+		}else if(strcmp(arg, "--help") == 0){
+			usage(argv[0]);
+			return 0;
+		}else if(value == NULL){
+			fprintf(stderr, "%s needs a value\n", arg);
+			return 1;
+		}else if(strcmp(arg, "--fps") == 0){
+			fps_list.push_back(atof(value));
+		}else if(strcmp(arg, "--seconds") == 0){
+			seconds = atof(value);
+		}else if(strcmp(arg, "--load") == 0){
+			int index = find_name(value, load_model_names, LOAD_MODEL_COUNT);
+			if(index < 0){
+				fprintf(stderr, "unknown load %s\n", value);
+				return 1;
+			}
+			load = &load_models[index];
+		}else if(strcmp(arg, "--backend") == 0){
+			only_backend = find_name(value, sleep_model_names, SLEEP_MODEL_COUNT);
+			if(only_backend < 0){
+				fprintf(stderr, "unknown backend %s\n", value);
+				return 1;
+			}
+		}else if(strcmp(arg, "--mode") == 0){
+			only_mode = find_name(value, pacing_mode_names, PACING_MODE_COUNT);
+			if(only_mode < 0){
+				fprintf(stderr, "unknown pacing mode %s\n", value);
+				return 1;
+			}
+		}else if(strcmp(arg, "--tick-mean-us") == 0){
+			ticks.mean_ns = atof(value) * 1000;
+		}else if(strcmp(arg, "--tick-jitter-us") == 0){
+			ticks.jitter_ns = atof(value) * 1000;
+		}else if(strcmp(arg, "--tick-spike-us") == 0){
+			ticks.spike_ns = atof(value) * 1000;
+		}else if(strcmp(arg, "--tick-spike-every") == 0){
+			ticks.spike_interval = atoi(value);
+		}else if(strcmp(arg, "--ticks") == 0){
+			if(!read_trace(value, &ticks.trace_ns)){
+				return 1;
+			}
+		}else if(strcmp(arg, "--seed") == 0){
+			seed = strtoull(value, NULL, 10);
+		}else{
+			fprintf(stderr, "unknown option %s\n", arg);
+			usage(argv[0]);
+			return 1;
+		}
+		if(takes_value){
+			i++;
+		}
+	}
+	if(fps_list.empty()){
+		fps_list.push_back(144);
+		fps_list.push_back(300);
+	}
+	for(double fps : fps_list){
+		if(!(fps > 0)){
+			fprintf(stderr, "fps has to be above 0\n");
+			return 1;
+		}
+	}
+
+	std::vector<struct strategy> strategies;
+	for(int backend = 0;backend < SLEEP_MODEL_COUNT;backend++){
+		if(only_backend >= 0 && backend != only_backend){
+			continue;
+		}
+		for(int mode = 0;mode < PACING_MODE_COUNT;mode++){
+			if(only_mode >= 0 && mode != only_mode){
+				continue;
+			}
+			if(sleep_models[backend].granularity_100ns == 0){
+				// nothing to buffer, everything is spun
+				strategies.push_back({backend, mode, false, false});
+				continue;
+			}
+			strategies.push_back({backend, mode, false, false});
+			strategies.push_back({backend, mode, true, false});
+		}
+	}
+
+	if(csv){
+		printf("fps,load,backend,mode,buffer,frames,mean_us,p99_us,p999_us,jitter_us,missed,spin_per_frame_us,spin_preemptions\n");
+	}else{
+		printf("load %s, %.0f simulated seconds per run, seed %llu\n", load->name, seconds, (unsigned long long)seed);
+		printf("%7s %-15s %-13s %-8s %7s %9s %9s %9s %9s %7s %10s %9s\n", "fps", "backend", "mode", "buffer", "frames", "mean us", "p99 us", "p99.9 us", "jitter us", "missed", "spin us/f", "preempts");
+	}
+	for(double fps : fps_list){
+		for(const struct strategy &strategy : strategies){
+			// every run sees the same load and tick costs
+			struct result r = run(&strategy, fps, load, &ticks, seconds * 1000 * 1000 * 1000, seed);
+			const char *buffer = sleep_models[strategy.sleep_model].granularity_100ns == 0 ? "-" : strategy.adaptive_busy_loop ? "adaptive" : "fixed";
+			if(csv){
+				printf("%.3f,%s,%s,%s,%s,%u,%.1f,%.1f,%.1f,%.1f,%u,%.1f,%u\n", fps, load->name, sleep_models[strategy.sleep_model].name, pacing_mode_names[strategy.pacing_mode], buffer,
+					r.frames, r.mean_ns / 1000, r.p99_ns / 1000.0, r.p999_ns / 1000.0, r.stddev_ns / 1000, r.missed, r.spin_per_frame_ns / 1000, r.preemptions);
+			}else{
+				printf("%7.2f %-15s %-13s %-8s %7u %9.1f %9.1f %9.1f %9.1f %7u %10.1f %9u\n", fps, sleep_models[strategy.sleep_model].name, pacing_mode_names[strategy.pacing_mode], buffer,
+					r.frames, r.mean_ns / 1000, r.p99_ns / 1000.0, r.p999_ns / 1000.0, r.stddev_ns / 1000, r.missed, r.spin_per_frame_ns / 1000, r.preemptions);
+			}
+		}
+	}
+	return 0;
+}
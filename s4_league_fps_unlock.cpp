@@ -1,3 +1,6 @@
+// for high resolution waitable timers and thread cycle time
+#define _WIN32_WINNT 0x0601
+
 #include <cstdio>
 #include <fcntl.h>
 #include <unistd.h>
@@ -7,16 +10,20 @@
 #include <cstring>
 #include <cmath>
 
-#include "json.hpp"
-#include <fstream>
-
 #include <time.h>
+#include <cpuid.h>
 
 #include <windows.h>
+#include <mmsystem.h>
 
 // mingw don't provide a mprotect wrap
 #include <memoryapi.h>
 
+// not in older mingw headers, windows 10 1803+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
 // http://undocumented.ntinternals.net/index.html?page=UserMode%2FUndocumented%20Functions%2FNT%20Objects%2FThread%2FNtDelayExecution.html
 extern "C"
 NTSYSAPI
@@ -51,43 +58,38 @@ NtSetTimerResolution(
     );
 
 static ULONG min_nt_delay_100ns;
+static ULONG max_nt_delay_100ns;
 
-#define ENABLE_LOGGING 0
-
-#if ENABLE_LOGGING
-FILE *log_file = NULL;
-char log_buf[500];
-pthread_mutex_t log_mutex;
+#include "binlog.h"
+#include "trace.h"
 
-#define LOG(...) \
+// always compiled in, a predictable branch on binlog_mask while a category's level is below the call's
+// records go to s4_league_fps_unlock.binlog while "logging" is on, binlog_decode turns it into text
+#define LOG_FILE_NAME "s4_league_fps_unlock.binlog"
+#define LOG_AT(level, ...) \
 { \
-	pthread_mutex_lock(&log_mutex); \
-	snprintf(log_buf, sizeof(log_buf), __VA_ARGS__); \
-	int _len = strlen(log_buf); \
-	if(_len + 1 < sizeof(log_buf)){ \
-		log_buf[_len] = '\n'; \
-		log_buf[_len + 1] = '\0'; \
+	if(__builtin_expect(binlog_on(BINLOG_BIT(LOG_CATEGORY, level)), 0)){ \
+		static uint16_t _binlog_format = 0; \
+		binlog_write(&_binlog_format, LOG_CATEGORY, level, __VA_ARGS__); \
 	} \
-	if(log_file != NULL){ \
-		fprintf(log_file, "%s", log_buf); \
-		fflush(log_file); \
-	}else{ \
-		printf("warning: log_file is NULL, logging to stdout \n"); \
-		printf("%s", log_buf); \
-	} \
-	pthread_mutex_unlock(&log_mutex); \
 }
-
-#else // ENABLE_LOGGING
-#define LOG(...)
-#endif //ENABLE_LOGGING
-
-#define VERBOSE 0
-#if VERBOSE
-	#define LOG_VERBOSE(...) LOG(__VA_ARGS__)
-#else // VERBOSE
-	#define LOG_VERBOSE(...)
-#endif //VERBOSE
+#define LOG(...) LOG_AT(BINLOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_VERBOSE(...) LOG_AT(BINLOG_LEVEL_VERBOSE, __VA_ARGS__)
+// whether a LOG or LOG_VERBOSE here would be recorded, for work only done to log
+#define LOG_ON(level) binlog_on(BINLOG_BIT(LOG_CATEGORY, level))
+
+// spans of the limiter, the game tick and the hooks go here while "tracing" is on
+#define TRACE_FILE_NAME "s4_league_fps_unlock.trace.json"
+
+// the category LOG and LOG_VERBOSE file records under, redefined before each part of this file
+#define LOG_CATEGORY BINLOG_CATEGORY_LIMITER
+#include "framelimiter.h"
+#undef LOG_CATEGORY
+#define LOG_CATEGORY BINLOG_CATEGORY_CONFIG
+#include "config_schema.h"
+#include "control_block.h"
+#undef LOG_CATEGORY
+#define LOG_CATEGORY BINLOG_CATEGORY_LIMITER
 
 // __sync_synchronize() is not enough..?
 #define INIT_MEM_FENCE() \
@@ -105,106 +107,722 @@ if(!_mem_fence_ready){ \
 pthread_mutex_lock(&_mem_fence); \
 pthread_mutex_unlock(&_mem_fence);
 
+// serializes the writers of config and the snapshot, the hooks never take it
 static pthread_mutex_t config_mutex;
-struct config{
-	int max_framerate;
-	int field_of_view;
-	int center_field_of_view;
-	int sprint_field_of_view;
-	bool framelimiter_full_busy_loop;
-	int framelimiter_busy_loop_buffer_100ns;
-};
 
 static float frametime;
+// whole milliseconds handed to the spread calculation instead of the game's delta, 0 leaves it alone
+// written by patched_game_tick, game thread only
+static uint32_t spread_frametime_override = 0;
 static uint64_t frametime_accumulated = 0;
 static uint8_t weapon_slot;
 static float set_drop_val;
 
-struct config config = {
-	.max_framerate = 300,
-	.field_of_view = 60,
-	.center_field_of_view = 66,
-	.sprint_field_of_view = 80,
-	.framelimiter_full_busy_loop = false,
-	.framelimiter_busy_loop_buffer_100ns = 15000,
+struct config config = config_defaults;
+
+// what the hooks read, a copy of config together with the values derived from it
+// published by publish_config_snapshot, read with read_config_snapshot
+struct config_snapshot{
+	struct config config;
+	// frametime target per game state, 0 when the frame limiter is off
+	// the fraction is in 1/2^32 ns and carried by the deadlines, so the long run rate is exact
+	uint64_t state_frametime_ns[GAME_STATE_COUNT];
+	uint32_t state_frametime_frac[GAME_STATE_COUNT];
+	int sleep_backend;
 };
+static struct config_snapshot config_snapshot;
+// seqlock over config_snapshot, odd while it is being written
+static uint32_t config_snapshot_seq = 0;
+
+// shared memory for external tools, NULL when it couldn't be created
+static struct control_block *control_block = NULL;
+// set by tools after writing a request
+static HANDLE control_event = NULL;
+// set by main_thread once deferred_init is done, the frame limiter and control block stay off until then
+static bool deferred_init_done = false;
+// times each fix kicked in, every counter is only written by the thread running its hook
+static uint32_t fix_counts[CONTROL_FIX_COUNT];
+
+// selected from the snapshot for the current game_state by select_target_frametime, game thread only
+static uint64_t target_frametime_ns = 0;
+static uint32_t target_frametime_frac = 0;
+static int game_state = GAME_STATE_MATCH;
+
+// window state is polled, the rest is checked every tick
+#define GAME_STATE_WINDOW_POLL_NS (100ull * 1000 * 1000)
+// ticks this long mean the game is loading, and it stays loading for a while after the last one
+#define GAME_STATE_LOADING_TICK_NS (100ull * 1000 * 1000)
+#define GAME_STATE_LOADING_HOLD_NS (1000ull * 1000 * 1000)
+// the game is in a match while it keeps moving actors
+#define GAME_STATE_MATCH_HOLD_NS (2000ull * 1000 * 1000)
+
+// written by patched_move_actor_by and record_game_tick, game thread only
+static uint64_t last_actor_move_ns = 0;
+static uint64_t last_loading_tick_ns = 0;
+// last value read by display_refresh_rate, for max_framerate_auto
+static double refresh_rate = 0;
+
+// limiter clock, the invariant tsc scaled to nanoseconds, or qpc when the tsc can't be trusted
+// both run on qpc's epoch so values from either source compare
+enum clock_source{
+	CLOCK_SOURCE_QPC,
+	CLOCK_SOURCE_TSC,
+};
+struct limiter_clock{
+	int source;
+	double ns_per_tick;
+	uint64_t base_ticks;
+	uint64_t base_ns;
+};
+// qpc from the constructor, the tsc once the deferred init calibrated it
+// switched as a whole by swapping the pointer, so no thread reads half of each
+static struct limiter_clock limiter_clocks[2];
+static const struct limiter_clock *limiter_clock = &limiter_clocks[0];
 
-static uint32_t target_frametime_ns = (1 * 1000 * 1000 * 1000) / config.max_framerate;
-static uint32_t target_frametime_100ns = target_frametime_ns / 100;
+#define TSC_CALIBRATION_MS 10
 
-static void parse_config(){
-	const char *config_file_name = "s4_league_fps_unlock.json";
-	std::ifstream config_file(config_file_name);
-	if(!config_file.good()){
-		LOG("failed opening %s for reading", config_file_name);
+static uint64_t qpc_ticks(){
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart;
+}
+
+static uint64_t clock_now_ns(){
+	const struct limiter_clock *c = __atomic_load_n(&limiter_clock, __ATOMIC_ACQUIRE);
+	uint64_t ticks = c->source == CLOCK_SOURCE_TSC ? __builtin_ia32_rdtsc() : qpc_ticks();
+	return c->base_ns + (int64_t)((int64_t)(ticks - c->base_ticks) * c->ns_per_tick);
+}
+
+static bool tsc_is_invariant(){
+	unsigned int eax, ebx, ecx, edx;
+	if(!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007){
+		return false;
+	}
+	__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+	return (edx & (1 << 8)) != 0;
+}
+
+// cheap enough for the constructor
+static void init_clock(){
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	limiter_clocks[0].source = CLOCK_SOURCE_QPC;
+	limiter_clocks[0].ns_per_tick = 1000.0 * 1000 * 1000 / frequency.QuadPart;
+	limiter_clocks[0].base_ticks = 0;
+	limiter_clocks[0].base_ns = 0;
+}
+
+// sleeps for TSC_CALIBRATION_MS, deferred init only
+static void calibrate_clock(){
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	double qpc_ns_per_tick = limiter_clocks[0].ns_per_tick;
+
+	if(!tsc_is_invariant()){
+		LOG("tsc is not invariant, limiter clock uses qpc at %lld Hz", frequency.QuadPart);
 		return;
 	}
 
-	nlohmann::json parsed_config_file;
-	try{
-		parsed_config_file = nlohmann::json::parse(config_file);
-	}catch(nlohmann::json::exception e){
-		LOG("failed parsing %s, %s", config_file_name, e.what());
+	// bracket each tsc read between two qpc reads and take the middle
+	uint64_t qpc_before = qpc_ticks();
+	uint64_t tsc_start = __builtin_ia32_rdtsc();
+	uint64_t qpc_start = (qpc_before + qpc_ticks()) / 2;
+	Sleep(TSC_CALIBRATION_MS);
+	qpc_before = qpc_ticks();
+	uint64_t tsc_end = __builtin_ia32_rdtsc();
+	uint64_t qpc_end = (qpc_before + qpc_ticks()) / 2;
+
+	if(tsc_end <= tsc_start || qpc_end <= qpc_start){
+		LOG("tsc calibration failed, limiter clock uses qpc at %lld Hz", frequency.QuadPart);
 		return;
 	}
 
-	struct config staging_config;
-	memcpy(&staging_config, &config, sizeof(struct config));
+	struct limiter_clock *tsc = &limiter_clocks[1];
+	tsc->source = CLOCK_SOURCE_TSC;
+	tsc->ns_per_tick = (qpc_end - qpc_start) * qpc_ns_per_tick / (tsc_end - tsc_start);
+	tsc->base_ticks = tsc_end;
+	tsc->base_ns = qpc_end * qpc_ns_per_tick;
+	__atomic_store_n(&limiter_clock, tsc, __ATOMIC_RELEASE);
+	LOG("limiter clock uses the invariant tsc at %.0f Hz", 1000.0 * 1000 * 1000 / tsc->ns_per_tick);
+}
 
-	try{
-		if(!parsed_config_file["max_framerate"].is_number()){
-			LOG("failed reading max_framerate from %s", config_file_name)
-		}else{
-			staging_config.max_framerate = parsed_config_file["max_framerate"];
-			if(staging_config.max_framerate > 0){
-				LOG_VERBOSE("setting max framerate to %d", staging_config.max_framerate);
+// the system timer resolution is only raised while something sleeps with a backend that needs it
+// users are a bitmask so the game thread and calibration don't drop each other's request
+enum timer_resolution_user{
+	TIMER_RESOLUTION_USER_LIMITER = 1 << 0,
+	TIMER_RESOLUTION_USER_CALIBRATION = 1 << 1,
+};
+static pthread_mutex_t timer_resolution_mutex;
+static uint32_t timer_resolution_users = 0;
+// read without the mutex by the frame limiter
+static bool timer_resolution_raised = false;
+static uint64_t timer_resolution_changed_ns = 0;
+// time spent at the default and at the raised resolution
+static uint64_t timer_resolution_time_ns[2] = {0};
+
+// keep the raised resolution for a while after the last frame that needed it, so state flapping doesn't flap it
+#define TIMER_RESOLUTION_RELEASE_NS (1000ull * 1000 * 1000)
+
+// caller holds timer_resolution_mutex
+static void log_timer_resolution_usage(){
+	LOG("timer resolution: %.1f s at %u * 100ns, %.1f s at the default %u * 100ns",
+		timer_resolution_time_ns[1] / 1e9, min_nt_delay_100ns, timer_resolution_time_ns[0] / 1e9, max_nt_delay_100ns);
+}
+
+// caller holds timer_resolution_mutex
+static void apply_timer_resolution(bool raise){
+	if(raise == timer_resolution_raised){
+		return;
+	}
+
+	ULONG current_nt_delay_100ns;
+	if(raise){
+		int i;
+		for(i = 0; i < 10; i++){
+			NtSetTimerResolution(min_nt_delay_100ns, true, &current_nt_delay_100ns);
+			if(min_nt_delay_100ns == current_nt_delay_100ns){
+				break;
 			}else{
-				LOG_VERBOSE("allowing game to go as fast as it can");
+				LOG("NtSetTimerResolution could not set delay to minimal, trying again");
 			}
 		}
-		if(!parsed_config_file["field_of_view"].is_number()){
-			LOG("failed reading field_of_view from %s, ", config_file_name)
-		}else{
-			staging_config.field_of_view = parsed_config_file["field_of_view"];
-			LOG_VERBOSE("setting field of view to %d", staging_config.field_of_view);
+		// for Sleep, which goes through winmm's own bookkeeping
+		timeBeginPeriod(1);
+	}else{
+		NtSetTimerResolution(min_nt_delay_100ns, false, &current_nt_delay_100ns);
+		timeEndPeriod(1);
+	}
+
+	uint64_t now_ns = clock_now_ns();
+	timer_resolution_time_ns[timer_resolution_raised] += now_ns - timer_resolution_changed_ns;
+	timer_resolution_changed_ns = now_ns;
+	__atomic_store_n(&timer_resolution_raised, raise, __ATOMIC_RELEASE);
+
+	LOG("timer resolution %s, now %u * 100ns", raise ? "raised" : "restored", current_nt_delay_100ns);
+	log_timer_resolution_usage();
+}
+
+static void timer_resolution_request(uint32_t user, bool want){
+	pthread_mutex_lock(&timer_resolution_mutex);
+	if(want){
+		timer_resolution_users |= user;
+	}else{
+		timer_resolution_users &= ~user;
+	}
+	apply_timer_resolution(timer_resolution_users != 0);
+	pthread_mutex_unlock(&timer_resolution_mutex);
+}
+
+struct sleep_backend{
+	const char *name;
+	// prepares the backend and reports its granularity, false if the system does not support it
+	bool (*init)(uint64_t *granularity_100ns);
+	// sleeps roughly sleep_100ns, which is already a multiple of granularity_100ns
+	void (*sleep)(uint64_t sleep_100ns);
+	// requests are rounded down to this, 0 means the backend never sleeps
+	uint64_t granularity_100ns;
+	// only accurate while the system timer resolution is raised
+	bool needs_timer_resolution;
+	bool available;
+};
+
+static bool nt_delay_init(uint64_t *granularity_100ns){
+	// set up by prepare_nt_timer
+	*granularity_100ns = min_nt_delay_100ns;
+	return min_nt_delay_100ns != 0;
+}
+
+static void nt_delay_sleep(uint64_t sleep_100ns){
+	LARGE_INTEGER sleep_li;
+	sleep_li.QuadPart = sleep_100ns;
+	sleep_li.QuadPart *= -1;
+	NtDelayExecution(false, &sleep_li);
+}
+
+// one timer per thread, the game thread and calibration can sleep at the same time
+static thread_local HANDLE waitable_timer = NULL;
+
+static HANDLE create_high_resolution_timer(){
+	return CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+}
+
+static bool waitable_timer_init(uint64_t *granularity_100ns){
+	HANDLE timer = create_high_resolution_timer();
+	if(timer == NULL){
+		LOG("high resolution waitable timers are not supported, error %lu", GetLastError());
+		return false;
+	}
+	CloseHandle(timer);
+	*granularity_100ns = 1;
+	return true;
+}
+
+static void waitable_timer_sleep(uint64_t sleep_100ns){
+	if(waitable_timer == NULL){
+		waitable_timer = create_high_resolution_timer();
+		if(waitable_timer == NULL){
+			return;
 		}
-		if(!parsed_config_file["center_field_of_view"].is_number()){
-			LOG("failed reading center_field_of_view from %s, ", config_file_name)
-		}else{
-			staging_config.center_field_of_view = parsed_config_file["center_field_of_view"];
-			LOG_VERBOSE("setting center field of view to %d", staging_config.center_field_of_view);
+	}
+	LARGE_INTEGER due_li;
+	due_li.QuadPart = sleep_100ns;
+	due_li.QuadPart *= -1;
+	if(SetWaitableTimer(waitable_timer, &due_li, 0, NULL, NULL, false)){
+		WaitForSingleObject(waitable_timer, INFINITE);
+	}
+}
+
+static bool sleep_init(uint64_t *granularity_100ns){
+	// timeBeginPeriod(1) is done by apply_timer_resolution
+	*granularity_100ns = 10000;
+	return true;
+}
+
+static void sleep_sleep(uint64_t sleep_100ns){
+	Sleep(sleep_100ns / 10000);
+}
+
+static bool spin_init(uint64_t *granularity_100ns){
+	*granularity_100ns = 0;
+	return true;
+}
+
+static void spin_sleep(uint64_t sleep_100ns){
+}
+
+static struct sleep_backend sleep_backends[SLEEP_BACKEND_COUNT] = {
+	[SLEEP_BACKEND_NT_DELAY] = {.name = "nt_delay", .init = nt_delay_init, .sleep = nt_delay_sleep, .needs_timer_resolution = true},
+	[SLEEP_BACKEND_WAITABLE_TIMER] = {.name = "waitable_timer", .init = waitable_timer_init, .sleep = waitable_timer_sleep, .needs_timer_resolution = false},
+	[SLEEP_BACKEND_SLEEP] = {.name = "sleep", .init = sleep_init, .sleep = sleep_sleep, .needs_timer_resolution = true},
+	[SLEEP_BACKEND_SPIN] = {.name = "spin", .init = spin_init, .sleep = spin_sleep, .needs_timer_resolution = false},
+};
+
+// picked by calibrate_sleep_backends, nt_delay until then
+static int calibrated_sleep_backend = SLEEP_BACKEND_NT_DELAY;
+
+// caller holds config_mutex
+static int select_sleep_backend(){
+	static int logged_backend = SLEEP_BACKEND_NT_DELAY;
+	int backend = config.framelimiter_sleep_backend;
+	if(backend == SLEEP_BACKEND_AUTO){
+		backend = calibrated_sleep_backend;
+	}else if(!sleep_backends[backend].available){
+		LOG("sleep backend %s is not available, using %s", sleep_backends[backend].name, sleep_backends[calibrated_sleep_backend].name);
+		backend = calibrated_sleep_backend;
+	}
+	if(backend != logged_backend){
+		LOG("frame limiter now sleeps with %s", sleep_backends[backend].name);
+		logged_backend = backend;
+	}
+	return backend;
+}
+
+static void init_sleep_backends(){
+	for(int i = 0;i < SLEEP_BACKEND_COUNT;i++){
+		struct sleep_backend *backend = &sleep_backends[i];
+		backend->available = backend->init(&backend->granularity_100ns);
+		LOG("sleep backend %s available %d, granularity %llu * 100ns", backend->name, backend->available, backend->granularity_100ns);
+	}
+}
+
+#define SLEEP_CALIBRATION_SAMPLES 64
+#define SLEEP_CALIBRATION_REQUEST_100NS 10000
+
+static int compare_uint64(const void *a, const void *b){
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+static uint64_t thread_cycles(){
+	ULONG64 cycles = 0;
+	QueryThreadCycleTime(GetCurrentThread(), &cycles);
+	return cycles;
+}
+
+// measures how late each backend wakes up and how much cpu it burns while sleeping
+// each backend is scored by the cpu time a wait costs once its p99 overshoot is covered by spinning, the cheapest one wins
+static int calibrate_sleep_backends(){
+	uint64_t samples[SLEEP_CALIBRATION_SAMPLES];
+	timer_resolution_request(TIMER_RESOLUTION_USER_CALIBRATION, true);
+
+	// spinning is 100% cpu, use it as the reference for the other backends' cycle counts
+	uint64_t spin_start_ns = clock_now_ns();
+	uint64_t spin_start_cycles = thread_cycles();
+	while(clock_now_ns() - spin_start_ns < SLEEP_CALIBRATION_REQUEST_100NS * 100){
+		__builtin_ia32_pause();
+	}
+	double spin_cycles_per_ns = (thread_cycles() - spin_start_cycles) / (double)(clock_now_ns() - spin_start_ns);
+
+	int best_backend = SLEEP_BACKEND_SPIN;
+	uint64_t best_score_ns = SLEEP_CALIBRATION_REQUEST_100NS * 100;
+	for(int i = 0;i < SLEEP_BACKEND_COUNT;i++){
+		struct sleep_backend *backend = &sleep_backends[i];
+		if(!backend->available || backend->granularity_100ns == 0){
+			continue;
 		}
-		if(!parsed_config_file["sprint_field_of_view"].is_number()){
-			LOG("failed reading sprint_field_of_view from %s, ", config_file_name)
-		}else{
-			staging_config.sprint_field_of_view = parsed_config_file["sprint_field_of_view"];
-			LOG_VERBOSE("setting sprint field of view to %d", staging_config.sprint_field_of_view);
+
+		uint64_t request_100ns = backend->granularity_100ns * (SLEEP_CALIBRATION_REQUEST_100NS / backend->granularity_100ns);
+		if(request_100ns == 0){
+			request_100ns = backend->granularity_100ns;
 		}
-		if(!parsed_config_file["framelimiter_full_busy_loop"].is_boolean()){
-			LOG("failed reading framelimiter_full_busy_loop from %s, ", config_file_name)
-		}else{
-			staging_config.framelimiter_full_busy_loop = parsed_config_file["framelimiter_full_busy_loop"];
-			LOG_VERBOSE("setting framelimiter full busy loop to %s", staging_config.framelimiter_full_busy_loop ? "true" : "false");
+
+		uint64_t total_ns = 0;
+		uint64_t start_cycles = thread_cycles();
+		for(int j = 0;j < SLEEP_CALIBRATION_SAMPLES;j++){
+			uint64_t before_ns = clock_now_ns();
+			backend->sleep(request_100ns);
+			uint64_t slept_ns = clock_now_ns() - before_ns;
+			samples[j] = slept_ns > request_100ns * 100 ? slept_ns - request_100ns * 100 : 0;
+			total_ns += slept_ns;
 		}
-		if(!parsed_config_file["framelimiter_busy_loop_buffer_100ns"].is_number()){
-			LOG("failed reading framelimiter_busy_loop_buffer_100ns from %s, ", config_file_name)
+		double cpu_ratio = 0;
+		if(spin_cycles_per_ns > 0 && total_ns > 0){
+			cpu_ratio = (thread_cycles() - start_cycles) / (double)total_ns / spin_cycles_per_ns;
+		}
+
+		qsort(samples, SLEEP_CALIBRATION_SAMPLES, sizeof(uint64_t), compare_uint64);
+		uint64_t median_ns = samples[SLEEP_CALIBRATION_SAMPLES / 2];
+		// nearest rank
+		uint64_t p99_ns = samples[(SLEEP_CALIBRATION_SAMPLES * 99 + 99) / 100 - 1];
+		uint64_t max_ns = samples[SLEEP_CALIBRATION_SAMPLES - 1];
+		uint64_t score_ns = request_100ns * 100 * cpu_ratio + p99_ns;
+		// normalize to the same wait length as spinning
+		score_ns = score_ns * SLEEP_CALIBRATION_REQUEST_100NS / request_100ns;
+
+		LOG("sleep backend %s: %llu * 100ns request overshoots median %llu ns, p99 %llu ns, max %llu ns, cpu %.1f%%, score %llu ns", backend->name, request_100ns, median_ns, p99_ns, max_ns, cpu_ratio * 100, score_ns);
+
+		if(score_ns < best_score_ns){
+			best_score_ns = score_ns;
+			best_backend = i;
+		}
+	}
+
+	timer_resolution_request(TIMER_RESOLUTION_USER_CALIBRATION, false);
+
+	LOG("sleep backend calibration picked %s", sleep_backends[best_backend].name);
+	return best_backend;
+}
+
+// exact refresh rate of the primary monitor, 0 if unknown
+static double display_refresh_rate(){
+	UINT32 path_count = 0;
+	UINT32 mode_count = 0;
+	if(GetDisplayConfigBufferSizes(QDC_ONLY_ACTIVE_PATHS, &path_count, &mode_count) == ERROR_SUCCESS && path_count > 0){
+		DISPLAYCONFIG_PATH_INFO *paths = (DISPLAYCONFIG_PATH_INFO *)calloc(path_count, sizeof(DISPLAYCONFIG_PATH_INFO));
+		DISPLAYCONFIG_MODE_INFO *modes = (DISPLAYCONFIG_MODE_INFO *)calloc(mode_count, sizeof(DISPLAYCONFIG_MODE_INFO));
+		double rate = 0;
+		if(paths != NULL && modes != NULL && QueryDisplayConfig(QDC_ONLY_ACTIVE_PATHS, &path_count, paths, &mode_count, modes, NULL) == ERROR_SUCCESS){
+			for(UINT32 i = 0;i < path_count;i++){
+				DISPLAYCONFIG_RATIONAL refresh = paths[i].targetInfo.refreshRate;
+				if(refresh.Denominator == 0){
+					continue;
+				}
+				UINT32 mode_idx = paths[i].sourceInfo.modeInfoIdx;
+				// the primary monitor's source sits at 0, 0 of the desktop
+				bool primary = mode_idx < mode_count && modes[mode_idx].infoType == DISPLAYCONFIG_MODE_INFO_TYPE_SOURCE && modes[mode_idx].sourceMode.position.x == 0 && modes[mode_idx].sourceMode.position.y == 0;
+				if(primary || rate == 0){
+					rate = (double)refresh.Numerator / refresh.Denominator;
+				}
+				if(primary){
+					break;
+				}
+			}
+		}
+		free(paths);
+		free(modes);
+		if(rate > 0){
+			return rate;
+		}
+	}
+
+	// whole Hz only
+	DEVMODEW dev_mode;
+	memset(&dev_mode, 0, sizeof(dev_mode));
+	dev_mode.dmSize = sizeof(dev_mode);
+	if(EnumDisplaySettingsW(NULL, ENUM_CURRENT_SETTINGS, &dev_mode) && dev_mode.dmDisplayFrequency > 1){
+		return dev_mode.dmDisplayFrequency;
+	}
+	return 0;
+}
+
+// caller holds config_mutex
+static double state_frametime(int state){
+	if(state != GAME_STATE_MATCH && config.state_limits[state].max_framerate >= 0){
+		double framerate = config.state_limits[state].max_framerate;
+		return framerate > 0 ? 1000.0 * 1000 * 1000 / framerate : 0;
+	}
+
+	if(config.framelimiter_frametime_ns > 0){
+		return config.framelimiter_frametime_ns;
+	}
+	double framerate = config.max_framerate;
+	if(config.max_framerate_auto){
+		framerate = refresh_rate > 0 ? refresh_rate + config.framelimiter_auto_offset : 0;
+	}
+	return framerate > 0 ? 1000.0 * 1000 * 1000 / framerate : 0;
+}
+
+#undef LOG_CATEGORY
+#define LOG_CATEGORY BINLOG_CATEGORY_CONFIG
+
+// rebuilds config_snapshot from config and the derived state, the running deadline is kept and the next frame uses it
+// the game thread never waits for this, it keeps using its previous copy until the next tick
+// caller holds config_mutex
+static void publish_config_snapshot(){
+	struct config_snapshot snapshot;
+	memcpy(&snapshot.config, &config, sizeof(struct config));
+	for(int state = 0;state < GAME_STATE_COUNT;state++){
+		double frametime_ns = state_frametime(state);
+		if(frametime_ns < 1){
+			snapshot.state_frametime_ns[state] = 0;
+			snapshot.state_frametime_frac[state] = 0;
 		}else{
-			staging_config.framelimiter_busy_loop_buffer_100ns = parsed_config_file["framelimiter_busy_loop_buffer_100ns"];
-			LOG_VERBOSE("setting framelimiter busy loop buffer (100ns) to %s", framelimiter_busy_loop_buffer_100ns);
+			snapshot.state_frametime_ns[state] = frametime_ns;
+			snapshot.state_frametime_frac[state] = (frametime_ns - snapshot.state_frametime_ns[state]) * 4294967296.0;
 		}
-	}catch(nlohmann::json::exception e){
-		LOG("failed reading %s after parsing, %s", config_file_name, e.what());
+		LOG_VERBOSE("%s target frametime now %llu + %u / 2^32 ns", game_state_names[state], snapshot.state_frametime_ns[state], snapshot.state_frametime_frac[state]);
 	}
+	snapshot.sleep_backend = select_sleep_backend();
+
+	uint32_t seq = __atomic_load_n(&config_snapshot_seq, __ATOMIC_RELAXED);
+	__atomic_store_n(&config_snapshot_seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(&config_snapshot, &snapshot, sizeof(struct config_snapshot));
+	__atomic_store_n(&config_snapshot_seq, seq + 2, __ATOMIC_RELEASE);
+
+	if(control_block != NULL){
+		struct control_config block_config;
+		control_config_from_config(&block_config, &config);
+		control_block_write_config(control_block, &block_config);
+	}
+}
 
-	if(memcmp(&config, &staging_config, sizeof(struct config)) != 0){
-		pthread_mutex_lock(&config_mutex);
-		memcpy(&config, &staging_config, sizeof(struct config));
-		if(config.max_framerate > 0){
-			target_frametime_ns = (1 * 1000 * 1000 * 1000) / config.max_framerate;
-			target_frametime_100ns = target_frametime_ns / 100;
+// refreshes a thread's own copy of the snapshot when a newer one was published, plain loads only
+// on the first call *seq has to be odd so the copy is always made
+static void read_config_snapshot(struct config_snapshot *copy, uint32_t *seq){
+	while(true){
+		uint32_t published_seq = __atomic_load_n(&config_snapshot_seq, __ATOMIC_ACQUIRE);
+		if(published_seq == *seq){
+			return;
+		}
+		if(published_seq & 1){
+			// being written right now, which takes a memcpy
+			__builtin_ia32_pause();
+			continue;
+		}
+		memcpy(copy, &config_snapshot, sizeof(struct config_snapshot));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if(__atomic_load_n(&config_snapshot_seq, __ATOMIC_RELAXED) == published_seq){
+			*seq = published_seq;
+			return;
+		}
+	}
+}
+
+// game thread only
+static void select_target_frametime(const struct config_snapshot *snapshot){
+	target_frametime_ns = snapshot->state_frametime_ns[game_state];
+	target_frametime_frac = snapshot->state_frametime_frac[game_state];
+}
+
+static bool full_busy_loop(const struct config_snapshot *snapshot){
+	int full_busy_loop = snapshot->config.state_limits[game_state].framelimiter_full_busy_loop;
+	if(game_state == GAME_STATE_MATCH || full_busy_loop < 0){
+		return snapshot->config.framelimiter_full_busy_loop;
+	}
+	return full_busy_loop != 0;
+}
+
+static int busy_loop_buffer_100ns(const struct config_snapshot *snapshot){
+	int buffer_100ns = snapshot->config.state_limits[game_state].framelimiter_busy_loop_buffer_100ns;
+	if(game_state == GAME_STATE_MATCH || buffer_100ns < 0){
+		return snapshot->config.framelimiter_busy_loop_buffer_100ns;
+	}
+	return buffer_100ns;
+}
+
+// re-reads the refresh rate for max_framerate_auto, the monitor mode might have changed
+static void refresh_auto_framerate(){
+	double rate = display_refresh_rate();
+	pthread_mutex_lock(&config_mutex);
+	if(rate != refresh_rate){
+		LOG("monitor refresh rate is now %f Hz", rate);
+		refresh_rate = rate;
+		publish_config_snapshot();
+	}
+	pthread_mutex_unlock(&config_mutex);
+}
+
+static const char *config_file_name = "s4_league_fps_unlock.json";
+
+// the file's top level config, in effect while no profile is
+// main thread only, as are the profile variables below
+static struct config base_config = config_defaults;
+// every profile in the file, precomputed on top of base_config
+static struct config_profiles profiles = {.count = 0, .active = -1};
+// index into profiles, -1 for base_config
+static int active_profile = -1;
+// active_profile as last read from the file
+static char file_active_profile[CONFIG_PROFILE_NAME_MAX] = "";
+
+// replaces the config in effect, main thread only
+static void set_config(const struct config *cfg){
+	pthread_mutex_lock(&config_mutex);
+	memcpy(&config, cfg, sizeof(struct config));
+	publish_config_snapshot();
+	pthread_mutex_unlock(&config_mutex);
+	// the refresh rate is otherwise only read every MAIN_THREAD_POLL_MS, max_framerate_auto may have just been turned on
+	if(config.max_framerate_auto){
+		refresh_auto_framerate();
+	}
+}
+
+// puts a precomputed config in effect, the game thread picks it up on its next tick
+static void activate_profile(int index, const char *reason){
+	const struct config *selected = index >= 0 ? &profiles.profiles[index].config : &base_config;
+	if(index != active_profile){
+		SYSTEMTIME time;
+		GetLocalTime(&time);
+		LOG("%04d-%02d-%02d %02d:%02d:%02d.%03d switching to profile %s by %s", time.wYear, time.wMonth, time.wDay, time.wHour, time.wMinute, time.wSecond, time.wMilliseconds,
+			index >= 0 ? profiles.profiles[index].name : "(top level)", reason);
+		active_profile = index;
+	}
+	if(memcmp(&config, selected, sizeof(struct config)) != 0){
+		set_config(selected);
+	}
+}
+
+static void parse_config(const char *content, size_t len){
+	struct config staging_config;
+	memcpy(&staging_config, &base_config, sizeof(struct config));
+	static struct config_profiles staging_profiles;
+	if(!config_parse(&staging_config, &staging_profiles, content, len, config_file_name)){
+		return;
+	}
+	memcpy(&base_config, &staging_config, sizeof(struct config));
+
+	// find the active profile again, indices may have moved
+	int previous = -1;
+	for(int i = 0;i < staging_profiles.count && active_profile >= 0;i++){
+		if(strcmp(staging_profiles.profiles[i].name, profiles.profiles[active_profile].name) == 0){
+			previous = i;
 		}
-		pthread_mutex_unlock(&config_mutex);
 	}
+
+	// a profile picked with a hotkey stays through edits, unless the file picks another one
+	int index = staging_profiles.active;
+	const char *file_active = index >= 0 ? staging_profiles.profiles[index].name : "";
+	if(strcmp(file_active, file_active_profile) == 0){
+		index = previous;
+	}
+	strcpy(file_active_profile, file_active);
+	memcpy(&profiles, &staging_profiles, sizeof(struct config_profiles));
+	active_profile = previous;
+	activate_profile(index, config_file_name);
+}
+
+// how often hotkeys are checked while any profile has one
+#define PROFILE_HOTKEY_POLL_MS 20
+
+static bool profile_hotkeys_configured(){
+	for(int i = 0;i < profiles.count;i++){
+		if(profiles.profiles[i].hotkey_key != 0){
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool key_down(int key){
+	return (GetAsyncKeyState(key) & 0x8000) != 0;
+}
+
+// a profile's hotkey switches to it, or back to the top level config when it is already active
+// only while the game is in the foreground, main thread only
+static void poll_profile_hotkeys(){
+	static bool was_down[CONFIG_MAX_PROFILES];
+	DWORD pid = 0;
+	GetWindowThreadProcessId(GetForegroundWindow(), &pid);
+	bool foreground = pid == GetCurrentProcessId();
+	int modifiers = (key_down(VK_CONTROL) ? CONFIG_HOTKEY_CTRL : 0) | (key_down(VK_MENU) ? CONFIG_HOTKEY_ALT : 0) | (key_down(VK_SHIFT) ? CONFIG_HOTKEY_SHIFT : 0);
+	for(int i = 0;i < profiles.count;i++){
+		const struct config_profile *profile = &profiles.profiles[i];
+		bool down = foreground && profile->hotkey_key != 0 && profile->hotkey_modifiers == modifiers && key_down(profile->hotkey_key);
+		if(down && !was_down[i]){
+			activate_profile(i == active_profile ? -1 : i, "hotkey");
+		}
+		was_down[i] = down;
+	}
+}
+
+// the file is read whole into a buffer this large and parsed in place
+#define CONFIG_FILE_MAX_SIZE (64 * 1024)
+
+// size, write time and content of the config file as last parsed, main thread only
+static bool config_file_loaded = false;
+static uint64_t config_file_size = 0;
+static uint64_t config_file_write_time = 0;
+static char config_file_content[CONFIG_FILE_MAX_SIZE];
+static size_t config_file_content_len = 0;
+
+// size and last write time of the config file, false when they can't be read
+static bool read_config_file_stamp(uint64_t *size, uint64_t *write_time){
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if(!GetFileAttributesExA(config_file_name, GetFileExInfoStandard, &attributes)){
+		return false;
+	}
+	*size = ((uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	*write_time = ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+// whether the config file differs from the one last read, by size and write time only
+static bool config_file_changed(){
+	uint64_t size;
+	uint64_t write_time;
+	if(!read_config_file_stamp(&size, &write_time)){
+		return false;
+	}
+	return !config_file_loaded || size != config_file_size || write_time != config_file_write_time;
+}
+
+// parses the config file only if it changed since the last time
+static void reload_config(){
+	uint64_t size;
+	uint64_t write_time;
+	if(!read_config_file_stamp(&size, &write_time)){
+		LOG("failed reading attributes of %s, error %lu", config_file_name, GetLastError());
+		return;
+	}
+	if(config_file_loaded && size == config_file_size && write_time == config_file_write_time){
+		return;
+	}
+
+	FILE *config_file = fopen(config_file_name, "rb");
+	if(config_file == NULL){
+		LOG("failed opening %s for reading", config_file_name);
+		return;
+	}
+	char content[CONFIG_FILE_MAX_SIZE];
+	size_t len = fread(content, 1, sizeof(content), config_file);
+	bool too_large = len == sizeof(content) && fgetc(config_file) != EOF;
+	fclose(config_file);
+	if(too_large){
+		LOG("%s is larger than %d bytes, not reading it", config_file_name, CONFIG_FILE_MAX_SIZE);
+		return;
+	}
+	config_file_size = size;
+	config_file_write_time = write_time;
+	if(config_file_loaded && len == config_file_content_len && memcmp(content, config_file_content, len) == 0){
+		LOG_VERBOSE("%s was touched but its content is the same", config_file_name);
+		return;
+	}
+	config_file_loaded = true;
+	memcpy(config_file_content, content, len);
+	config_file_content_len = len;
+	LOG("reading %s", config_file_name);
+	parse_config(config_file_content, config_file_content_len);
 }
 
 struct __attribute__ ((packed)) time_context{
@@ -237,6 +855,9 @@ struct ctx_01642f30{
 };
 static struct ctx_01642f30 *(*fetch_ctx_01642f30)(void) = (struct ctx_01642f30 *(*)(void)) 0x004ae0a0;
 
+#undef LOG_CATEGORY
+#define LOG_CATEGORY BINLOG_CATEGORY_SPREAD
+
 struct funny_value{
 	uint32_t value_xor;
 	uint32_t value_xor_flip;
@@ -270,12 +891,18 @@ struct ctx_calculate_random_spread{
 
 static void (__attribute__((thiscall)) *orig_calculate_weapon_spread)(struct ctx_calculate_random_spread *, uint32_t, uint8_t);
 void __attribute__((thiscall)) patched_calculate_weapon_spread(struct ctx_calculate_random_spread *ctx, uint32_t frametime_param, uint8_t param_2){
+	uint64_t span_ns = trace_begin();
 	uint32_t orig_inner_spread_recovery = get_funny_value(&ctx->inner_spread_recovery);
 	uint32_t orig_outer_spread_recovery = get_funny_value(&ctx->outer_spread_recovery);
 	uint32_t orig_inner_spread_change = get_funny_value(&ctx->inner_spread_change);
 	uint32_t orig_outer_spread_change = get_funny_value(&ctx->outer_spread_change);
 
+	if(spread_frametime_override != 0){
+		frametime_param = spread_frametime_override;
+	}
+
 	if(ctx->spread_type == 2){
+		fix_counts[CONTROL_FIX_SPREAD]++;
 		// scale change up before the function
 		const double orig_fixed_frametime = 1.66666666666666678509045596002E1; // this gives a split of 16 and 17 frametimes given it's s4
 		float orig_frametime_divided_by_frametime = orig_fixed_frametime / (frametime_param * 1.0);
@@ -292,17 +919,18 @@ void __attribute__((thiscall)) patched_calculate_weapon_spread(struct ctx_calcul
 	set_funny_value(&ctx->inner_spread_change, &orig_inner_spread_change);
 	set_funny_value(&ctx->outer_spread_change, &orig_outer_spread_change);
 
-	#if ENABLE_LOGGING
-	uint32_t inner_verdict = get_funny_value(&(ctx->inner_verdict));
-	float inner_verdict_f = *(float *)&inner_verdict;
-	uint32_t outer_verdict = get_funny_value(&(ctx->outer_verdict));
-	float outer_verdict_f = *(float *)&outer_verdict;
-	#endif
-	LOG_VERBOSE("%s: ctx 0x%08x", __FUNCTION__, ctx);
-	LOG_VERBOSE("%s: frametime_param: %u, param_2: %u", __FUNCTION__, frametime_param, param_2);
-	LOG_VERBOSE("%s: inner_verdict: %f, outer_verdict: %f", __FUNCTION__, inner_verdict_f, outer_verdict_f);
-	LOG_VERBOSE("%s: ret chain 0x%08x -> 0x%08x -> 0x%08x -> 0x%08x", __FUNCTION__, __builtin_return_address(0), __builtin_return_address(1), __builtin_return_address(2), __builtin_return_address(3));
+	if(LOG_ON(BINLOG_LEVEL_VERBOSE)){
+		uint32_t inner_verdict = get_funny_value(&(ctx->inner_verdict));
+		float inner_verdict_f = *(float *)&inner_verdict;
+		uint32_t outer_verdict = get_funny_value(&(ctx->outer_verdict));
+		float outer_verdict_f = *(float *)&outer_verdict;
+		LOG_VERBOSE("%s: ctx 0x%08x", __FUNCTION__, ctx);
+		LOG_VERBOSE("%s: frametime_param: %u, param_2: %u", __FUNCTION__, frametime_param, param_2);
+		LOG_VERBOSE("%s: inner_verdict: %f, outer_verdict: %f", __FUNCTION__, inner_verdict_f, outer_verdict_f);
+		LOG_VERBOSE("%s: ret chain 0x%08x -> 0x%08x -> 0x%08x -> 0x%08x", __FUNCTION__, __builtin_return_address(0), __builtin_return_address(1), __builtin_return_address(2), __builtin_return_address(3));
+	}
 
+	trace_end(__FUNCTION__, span_ns);
 	return;
 }
 
@@ -338,25 +966,35 @@ static void hook_calculate_weapon_spread(){
 }
 
 // can change active fov by hooking this
+#undef LOG_CATEGORY
+#define LOG_CATEGORY BINLOG_CATEGORY_FOV
+
 struct ctx_fun_00766000{
 	uint8_t unknown[0x158];
 	float target_fov;
 };
 static void (__attribute__((thiscall)) *orig_fun_00766000)(void *, uint32_t);
 void __attribute__((thiscall)) patched_fun_00766000(struct ctx_fun_00766000 *ctx, uint32_t param_1){
+	uint64_t span_ns = trace_begin();
+	static thread_local struct config_snapshot snapshot;
+	static thread_local uint32_t snapshot_seq = 1;
+	read_config_snapshot(&snapshot, &snapshot_seq);
+
 	float orig_fov = ctx->target_fov;
-	pthread_mutex_lock(&config_mutex);
 	if(ctx->target_fov == 60.0){
-		ctx->target_fov = config.field_of_view;
+		ctx->target_fov = snapshot.config.field_of_view;
 	}else if(ctx->target_fov == 66.0){
-		ctx->target_fov = config.center_field_of_view;
+		ctx->target_fov = snapshot.config.center_field_of_view;
 	}else if(ctx->target_fov == 80.0){
-		ctx->target_fov = config.sprint_field_of_view;
+		ctx->target_fov = snapshot.config.sprint_field_of_view;
+	}
+	if(ctx->target_fov != orig_fov){
+		fix_counts[CONTROL_FIX_FOV]++;
 	}
-	pthread_mutex_unlock(&config_mutex);
 	LOG_VERBOSE("%s: ctx 0x%08x, current fov %f, override fov %f", __FUNCTION__, ctx, orig_fov, ctx->target_fov);
 	orig_fun_00766000(ctx, param_1);
 	ctx->target_fov = orig_fov;
+	trace_end(__FUNCTION__, span_ns);
 }
 
 static void hook_fun_00766000(){
@@ -391,18 +1029,23 @@ static void hook_fun_00766000(){
 }
 
 // this is a looong function with a lot of branches, but it seems to use the SetDrop value during a jump attack
+#undef LOG_CATEGORY
+#define LOG_CATEGORY BINLOG_CATEGORY_MOVEMENT
+
 struct ctx_fun_005e4020{
 	uint8_t unknown[0x2cc + 0x4];
 	float set_drop_val;
 };
 static void (__attribute__((thiscall)) *orig_fun_005e4020)(void *, uint32_t);
 void __attribute__((thiscall)) patched_fun_005e4020(struct ctx_fun_005e4020 *ctx, uint32_t param_1){
+	uint64_t span_ns = trace_begin();
 	orig_fun_005e4020(ctx, param_1);
 	if((void *)0x0051f508 == __builtin_return_address(1)){
 		set_drop_val = ctx->set_drop_val;
 		LOG_VERBOSE("%s: updating player set_drop_val to %f", __FUNCTION__, set_drop_val);
 	}
 	LOG_VERBOSE("%s: ctx 0x%08x, param_1 %u, set_drop_val %f, 0x%08x -> 0x%08x -> 0x%08x", __FUNCTION__, ctx, param_1, ctx->set_drop_val, __builtin_return_address(2), __builtin_return_address(1), __builtin_return_address(0));
+	trace_end(__FUNCTION__, span_ns);
 }
 
 static void hook_fun_005e4020(){
@@ -443,6 +1086,7 @@ struct __attribute__((packed)) switch_weapon_slot_ctx{
 };
 static void (__attribute__((thiscall)) *orig_switch_weapon_slot)(void*, uint32_t);
 void __attribute__((thiscall)) patched_switch_weapon_slot(struct switch_weapon_slot_ctx *ctx, uint32_t param_1){
+	uint64_t span_ns = trace_begin();
 	INIT_MEM_FENCE();
 	orig_switch_weapon_slot(ctx, param_1);
 	MEM_FENCE();
@@ -451,6 +1095,7 @@ void __attribute__((thiscall)) patched_switch_weapon_slot(struct switch_weapon_s
 		weapon_slot = ctx->weapon_slot;
 	}
 	LOG_VERBOSE("%s: ctx 0x%08x, param_1 %u, weapon slot switched to %u, 0x%08x -> 0x%08x", __FUNCTION__, ctx, param_1, weapon_slot, __builtin_return_address(1), __builtin_return_address(0));
+	trace_end(__FUNCTION__, span_ns);
 }
 static void hook_switch_weapon_slot(){
 	LOG("hooking switch_weapon_slot");
@@ -493,11 +1138,13 @@ struct __attribute__ ((packed)) move_actor_by_ctx{
 };
 static void (__attribute__((thiscall)) *orig_move_actor_by)(void*, float, float, float);
 void __attribute__((thiscall)) patched_move_actor_by(struct move_actor_by_ctx *ctx, float param_1, float param_2, float param_3){
+	uint64_t span_ns = trace_begin();
 	const double orig_fixed_frametime = 1.66666666666666678509045596002E1;
 
 	void *ret_addr = __builtin_return_address(0);
 
 	struct ctx_01642f30* actx = fetch_ctx_01642f30();
+	last_actor_move_ns = clock_now_ns();
 
 	LOG_VERBOSE("%s: ctx 0x%08x, param_1 %f, param_2 %f, param_3 %f", __FUNCTION__, ctx, param_1, param_2, param_3);
 	LOG_VERBOSE("%s: called from 0x%08x -> 0x%08x -> 0x%08x", __FUNCTION__, __builtin_return_address(2), __builtin_return_address(1), ret_addr);
@@ -542,6 +1189,7 @@ void __attribute__((thiscall)) patched_move_actor_by(struct move_actor_by_ctx *c
 
 			y = param_2 * modifier;
 			was_flying = true;
+			fix_counts[CONTROL_FIX_FLY]++;
 			LOG_VERBOSE("%s: applying fly speed fix, y %f, y/param_2 %f", __FUNCTION__, y, modifier);
 		}
 
@@ -550,6 +1198,7 @@ void __attribute__((thiscall)) patched_move_actor_by(struct move_actor_by_ctx *c
 		if(actx->actor_state == 63){
 			// approx, would allow different servers with different lua values to work, that is if this is tuned in lua at all...
 			if(param_2 > 0){
+				fix_counts[CONTROL_FIX_SCYTHE_UPPERCUT]++;
 				float frametime_ratio = 17.0 / frametime;
 				if(frametime <= 13.0){
 					// >= 70 fps ish
@@ -600,6 +1249,7 @@ void __attribute__((thiscall)) patched_move_actor_by(struct move_actor_by_ctx *c
 					// spike the first drop frame to the 60fps value
 					// rare but there could be extra frames before
 					y = -850.0;
+					fix_counts[CONTROL_FIX_PS_DROP]++;
 					LOG_VERBOSE("%s: applying ps drop speed fix, y/param_2 %f", __FUNCTION__, y / param_2);
 					first_ps_drop_frame = false;
 				}else{
@@ -625,6 +1275,7 @@ void __attribute__((thiscall)) patched_move_actor_by(struct move_actor_by_ctx *c
 	}
 
 	orig_move_actor_by(ctx, param_1, y, param_3);
+	trace_end(__FUNCTION__, span_ns);
 }
 
 static void hook_move_actor_by(){
@@ -668,6 +1319,7 @@ struct __attribute__ ((packed)) move_actor_exact_ctx{
 };
 static void (__attribute__((thiscall)) *orig_move_actor_exact)(void*, float, float, float, uint32_t);
 void __attribute__((thiscall)) patched_move_actor_exact(struct move_actor_exact_ctx *ctx, float param_1, float param_2, float param_3, uint32_t param_4){
+	uint64_t span_ns = trace_begin();
 	INIT_MEM_FENCE()
 	float before_x = ctx->x;
 	float before_y = ctx->y;
@@ -693,6 +1345,7 @@ void __attribute__((thiscall)) patched_move_actor_exact(struct move_actor_exact_
 	LOG_VERBOSE("%s: %f->%f %f->%f %f->%f", __FUNCTION__, before_x, after_x, before_y, after_y, before_z, after_z);
 	LOG_VERBOSE("%s: %f %f %f", __FUNCTION__, after_x - before_x, after_y - before_y, after_z - before_z);
 	LOG_VERBOSE("%s: return addr: 0x%08x", __FUNCTION__, ret_addr);
+	trace_end(__FUNCTION__, span_ns);
 }
 
 static void hook_move_actor_exact(){
@@ -764,9 +1417,535 @@ static void redirect_speed_dampeners(){
 	*patch_location = (uint32_t)&speed_dampeners[8];
 }
 
+#undef LOG_CATEGORY
+#define LOG_CATEGORY BINLOG_CATEGORY_LIMITER
+
+static struct frame_pacer pacer = {0};
+// the game thread's copy of the snapshot, refreshed at the start of every tick
+static struct config_snapshot tick_config;
+static uint32_t tick_config_seq = 1;
+
+// windows implementation of the frame limiter's platform calls, the linux one is in framelimiter_linux.h
+static uint64_t win32_now_ns(void *user){
+	return clock_now_ns();
+}
+
+static void win32_sleep(void *user, uint64_t sleep_100ns){
+	uint64_t span_ns = trace_begin();
+	sleep_backends[tick_config.sleep_backend].sleep(sleep_100ns);
+	trace_end("limiter sleep", span_ns);
+}
+
+static void win32_pause(void *user, uint32_t pauses){
+	for(uint32_t i = 0;i < pauses;i++){
+		__builtin_ia32_pause();
+	}
+}
+
+// the game's own millisecond clock, read the same way the game reads it
+static double win32_game_clock_ms(void *user){
+	static struct time_context clock_ctx;
+	update_time_delta(&clock_ctx);
+	return clock_ctx.last_t;
+}
+
+// runs the final spin at time critical priority, so background threads can't take the core right before the deadline
+// game thread only
+static void win32_spin_phase(void *user, bool spinning){
+	static bool boosted = false;
+	static int saved_priority = THREAD_PRIORITY_NORMAL;
+	static uint64_t span_ns = 0;
+	if(spinning){
+		span_ns = trace_begin();
+	}else{
+		trace_end("limiter spin", span_ns);
+		span_ns = 0;
+	}
+	if(spinning && tick_config.config.framelimiter_boost_spin_priority && !boosted){
+		saved_priority = GetThreadPriority(GetCurrentThread());
+		if(saved_priority != THREAD_PRIORITY_ERROR_RETURN && SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)){
+			boosted = true;
+		}
+	}else if(!spinning && boosted){
+		SetThreadPriority(GetCurrentThread(), saved_priority);
+		boosted = false;
+	}
+}
+
+static const struct framelimiter_env win32_framelimiter_env = {
+	.now_ns = win32_now_ns,
+	.sleep = win32_sleep,
+	.pause = win32_pause,
+	.game_clock_ms = win32_game_clock_ms,
+	.spin_phase = win32_spin_phase,
+	.user = NULL,
+};
+
+// avrt.dll is loaded on first use, so the asi doesn't depend on it
+static HANDLE (WINAPI *av_set_mm_thread_characteristics)(LPCWSTR, LPDWORD) = NULL;
+static BOOL (WINAPI *av_revert_mm_thread_characteristics)(HANDLE) = NULL;
+
+static bool load_avrt(){
+	if(av_set_mm_thread_characteristics != NULL){
+		return true;
+	}
+	HMODULE avrt = LoadLibraryW(L"avrt.dll");
+	if(avrt == NULL){
+		LOG("failed loading avrt.dll, error %lu", GetLastError());
+		return false;
+	}
+	av_revert_mm_thread_characteristics = (BOOL (WINAPI *)(HANDLE))GetProcAddress(avrt, "AvRevertMmThreadCharacteristics");
+	av_set_mm_thread_characteristics = (HANDLE (WINAPI *)(LPCWSTR, LPDWORD))GetProcAddress(avrt, "AvSetMmThreadCharacteristicsW");
+	if(av_set_mm_thread_characteristics == NULL || av_revert_mm_thread_characteristics == NULL){
+		LOG("avrt.dll is missing the mmcss functions");
+		av_set_mm_thread_characteristics = NULL;
+		return false;
+	}
+	return true;
+}
+
+// registers the game thread with the multimedia class scheduler as a "Games" task while framelimiter_mmcss is on
+// game thread only
+static void update_game_thread_mmcss(const struct config *cfg){
+	static HANDLE mmcss_task = NULL;
+	// don't retry every frame after it failed once
+	static bool mmcss_failed = false;
+	if(cfg->framelimiter_mmcss && mmcss_task == NULL && !mmcss_failed){
+		DWORD task_index = 0;
+		if(load_avrt()){
+			mmcss_task = av_set_mm_thread_characteristics(L"Games", &task_index);
+		}
+		if(mmcss_task == NULL){
+			LOG("failed registering the game thread with mmcss, error %lu", GetLastError());
+			mmcss_failed = true;
+		}else{
+			LOG("game thread registered with mmcss as Games, task index %lu", task_index);
+		}
+	}else if(!cfg->framelimiter_mmcss && mmcss_task != NULL){
+		av_revert_mm_thread_characteristics(mmcss_task);
+		mmcss_task = NULL;
+		LOG("game thread unregistered from mmcss");
+	}else if(!cfg->framelimiter_mmcss){
+		mmcss_failed = false;
+	}
+}
+
+// logical processor the game thread last ran on, -1 until the first tick
+static int game_thread_processor = -1;
+
+// all logical processors sharing a physical core with processor, so smt siblings are avoided too
+static DWORD_PTR processor_core_mask(int processor){
+	DWORD_PTR processor_mask = (DWORD_PTR)1 << processor;
+	DWORD length = 0;
+	GetLogicalProcessorInformation(NULL, &length);
+	if(length == 0){
+		return processor_mask;
+	}
+	SYSTEM_LOGICAL_PROCESSOR_INFORMATION *info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION *)malloc(length);
+	if(info == NULL){
+		return processor_mask;
+	}
+	DWORD_PTR core_mask = processor_mask;
+	if(GetLogicalProcessorInformation(info, &length)){
+		for(DWORD i = 0;i < length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);i++){
+			if(info[i].Relationship == RelationProcessorCore && (info[i].ProcessorMask & processor_mask)){
+				core_mask = info[i].ProcessorMask;
+				break;
+			}
+		}
+	}
+	free(info);
+	return core_mask;
+}
+
+// the cores the mod's own threads may run on, 0 until main_thread first worked it out
+static DWORD_PTR background_affinity_mask = 0;
+
+// moves the calling thread onto background_affinity_mask when that changed since its last call
+// main_thread and the log and trace writers call it, each on its own thread
+static void follow_background_affinity(){
+	static thread_local DWORD_PTR applied_mask = 0;
+	DWORD_PTR mask = __atomic_load_n(&background_affinity_mask, __ATOMIC_RELAXED);
+	if(mask == 0 || mask == applied_mask){
+		return;
+	}
+	if(SetThreadAffinityMask(GetCurrentThread(), mask) == 0){
+		LOG("failed setting thread affinity to 0x%08lx, error %lu", (unsigned long)mask, GetLastError());
+	}
+	// not retried every wake when it failed
+	applied_mask = mask;
+}
+
+// keeps main_thread and the log and trace writers off the core the game thread runs on while framelimiter_isolate_game_core is on
+// the game thread itself is not pinned, this follows it every main_thread iteration, the writers pick it up on their next flush
+static void update_main_thread_affinity(){
+	DWORD_PTR process_mask;
+	DWORD_PTR system_mask;
+	if(!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)){
+		return;
+	}
+	DWORD_PTR applied_mask = __atomic_load_n(&background_affinity_mask, __ATOMIC_RELAXED);
+	if(applied_mask == 0){
+		applied_mask = process_mask;
+	}
+
+	pthread_mutex_lock(&config_mutex);
+	bool isolate = config.framelimiter_isolate_game_core;
+	pthread_mutex_unlock(&config_mutex);
+
+	DWORD_PTR mask = process_mask;
+	int processor = __atomic_load_n(&game_thread_processor, __ATOMIC_RELAXED);
+	if(isolate && processor >= 0 && processor < (int)(sizeof(DWORD_PTR) * 8)){
+		DWORD_PTR without_core = process_mask & ~processor_core_mask(processor);
+		// nothing left on a single core machine
+		if(without_core != 0){
+			mask = without_core;
+		}
+	}
+	if(mask == applied_mask){
+		return;
+	}
+	LOG("background thread affinity set to 0x%08lx, game thread last seen on processor %d", (unsigned long)mask, processor);
+	__atomic_store_n(&background_affinity_mask, mask, __ATOMIC_RELAXED);
+	follow_background_affinity();
+}
+
+// what the pacing logic needs from the config, target and backend state for this frame
+// game thread only
+static struct framelimiter_settings current_framelimiter_settings(const struct config_snapshot *snapshot){
+	const struct sleep_backend *backend = &sleep_backends[snapshot->sleep_backend];
+	struct framelimiter_settings settings = {
+		.target_frametime_ns = target_frametime_ns,
+		.target_frametime_frac = target_frametime_frac,
+		.pacing_mode = snapshot->config.framelimiter_pacing_mode,
+		.full_busy_loop = full_busy_loop(snapshot),
+		.busy_loop_buffer_100ns = busy_loop_buffer_100ns(snapshot),
+		.adaptive_busy_loop = snapshot->config.framelimiter_adaptive_busy_loop,
+		.busy_loop_budget_percent = snapshot->config.framelimiter_busy_loop_budget_percent,
+		.jit_margin_100ns = snapshot->config.framelimiter_jit_margin_100ns,
+		.sleep_backend = snapshot->sleep_backend,
+		.sleep_backend_name = backend->name,
+		.sleep_granularity_100ns = backend->granularity_100ns,
+		// without the raised resolution the backend is too coarse to be worth measuring or spinning after
+		.coarse_only = backend->needs_timer_resolution && !__atomic_load_n(&timer_resolution_raised, __ATOMIC_ACQUIRE),
+	};
+	return settings;
+}
+
+// called after every orig_game_tick with its start and end time
+static void record_game_tick(uint64_t start_ns, uint64_t end_ns){
+	if(end_ns - start_ns > GAME_STATE_LOADING_TICK_NS){
+		last_loading_tick_ns = end_ns;
+	}
+	framelimiter_record_tick(&pacer, start_ns, end_ns);
+}
+
+// distribution of the delta_t the game reports, in whole milliseconds
+#define DELTA_T_BUCKETS 34
+#define DELTA_T_LOG_INTERVAL_FRAMES 1024
+static uint32_t delta_t_histogram[DELTA_T_BUCKETS];
+static uint32_t delta_t_samples = 0;
+
+static void record_delta_t(double delta_t){
+	int bucket = delta_t < 0 ? 0 : lround(delta_t);
+	if(bucket >= DELTA_T_BUCKETS){
+		bucket = DELTA_T_BUCKETS - 1;
+	}
+	delta_t_histogram[bucket]++;
+	delta_t_samples++;
+
+	if(delta_t_samples < DELTA_T_LOG_INTERVAL_FRAMES){
+		return;
+	}
+	if(LOG_ON(BINLOG_LEVEL_INFO)){
+		char distribution[300];
+		int len = 0;
+		for(int i = 0;i < DELTA_T_BUCKETS && len < (int)sizeof(distribution);i++){
+			if(delta_t_histogram[i] != 0){
+				len += snprintf(&distribution[len], sizeof(distribution) - len, " %d%s ms: %.1f%%", i, i == DELTA_T_BUCKETS - 1 ? "+" : "", delta_t_histogram[i] * 100.0 / delta_t_samples);
+			}
+		}
+		LOG("delta_t over the last %u frames:%s", delta_t_samples, distribution);
+	}
+	memset(delta_t_histogram, 0, sizeof(delta_t_histogram));
+	delta_t_samples = 0;
+}
+
+// the game's clock only moves in whole milliseconds, this one follows it on the limiter clock with fractional milliseconds
+// it is anchored to the game's clock so both read the same time, and anchored again if they drift apart
+#define HIGH_RESOLUTION_CLOCK_MAX_DRIFT_MS 2.0
+struct high_resolution_clock{
+	bool anchored;
+	double base_ms;
+	uint64_t base_ns;
+	double last_t;
+	double delta_t;
+};
+static struct high_resolution_clock high_resolution_clock = {0};
+
+// game thread only, call right after update_time_delta with the same game_ctx
+static void update_high_resolution_clock(const struct time_context *game_ctx, uint64_t now_ns){
+	struct high_resolution_clock *c = &high_resolution_clock;
+	double t = c->base_ms + (now_ns - c->base_ns) / (1000.0 * 1000);
+	if(!c->anchored || fabs(t - game_ctx->last_t) > HIGH_RESOLUTION_CLOCK_MAX_DRIFT_MS){
+		if(c->anchored){
+			LOG("high resolution clock drifted %f ms from the game's clock, anchoring it again", t - game_ctx->last_t);
+		}else{
+			// the first delta is the game's
+			c->last_t = game_ctx->last_t - game_ctx->delta_t;
+			c->anchored = true;
+		}
+		c->base_ms = game_ctx->last_t;
+		c->base_ns = now_ns;
+		t = game_ctx->last_t;
+	}
+	c->delta_t = t - c->last_t;
+	c->last_t = t;
+}
+
+// smoothing between the measured frame duration and the fixes
+// how quickly the clamp filter's reference follows accepted frames
+#define FRAMETIME_FILTER_CLAMP_ALPHA (1.0 / 16)
+#define FRAMETIME_FILTER_STATS_INTERVAL_FRAMES 1024
+struct frametime_filter_state{
+	// the filter the state below was built for, it starts over when that changes
+	int filter;
+	double ema;
+	double window[FRAMETIME_FILTER_MAX_WINDOW];
+	int window_len;
+	int window_pos;
+	double clamp_reference;
+	// over the current stats interval
+	uint32_t frames;
+	uint32_t clamped;
+	double raw_sum;
+	double raw_sq_sum;
+	double raw_max;
+	double filtered_sum;
+	double filtered_sq_sum;
+	double filtered_max;
+};
+static struct frametime_filter_state frametime_filter_state = {.filter = -1};
+
+static int compare_double(const void *a, const void *b){
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void log_frametime_filter_stats(struct frametime_filter_state *f){
+	double raw_mean = f->raw_sum / f->frames;
+	double filtered_mean = f->filtered_sum / f->frames;
+	double raw_var = f->raw_sq_sum / f->frames - raw_mean * raw_mean;
+	double filtered_var = f->filtered_sq_sum / f->frames - filtered_mean * filtered_mean;
+	LOG("frametime filter %s over %u frames: raw mean %.3f ms, stddev %.3f ms, max %.3f ms | filtered mean %.3f ms, stddev %.3f ms, max %.3f ms, %u clamped",
+		frametime_filter_names[f->filter], f->frames,
+		raw_mean, sqrt(raw_var > 0 ? raw_var : 0), f->raw_max,
+		filtered_mean, sqrt(filtered_var > 0 ? filtered_var : 0), f->filtered_max, f->clamped);
+}
+
+// the one place frametime is written, every hook reads the result from there
+// game thread only
+static void publish_frametime(double raw_ms, int filter, double ema_alpha, int median_window, double clamp_percent){
+	struct frametime_filter_state *f = &frametime_filter_state;
+	if(f->filter != filter){
+		if(f->frames != 0){
+			log_frametime_filter_stats(f);
+		}
+		memset(f, 0, sizeof(struct frametime_filter_state));
+		f->filter = filter;
+		f->ema = raw_ms;
+		f->clamp_reference = raw_ms;
+	}
+
+	double filtered_ms = raw_ms;
+	switch(filter){
+		case FRAMETIME_FILTER_EMA:{
+			if(!(ema_alpha > 0) || ema_alpha > 1){
+				ema_alpha = 1;
+			}
+			f->ema += ema_alpha * (raw_ms - f->ema);
+			filtered_ms = f->ema;
+			break;
+		}
+		case FRAMETIME_FILTER_MEDIAN:{
+			if(median_window < 1){
+				median_window = 1;
+			}else if(median_window > FRAMETIME_FILTER_MAX_WINDOW){
+				median_window = FRAMETIME_FILTER_MAX_WINDOW;
+			}
+			if(f->window_len > median_window){
+				f->window_len = median_window;
+				f->window_pos = 0;
+			}
+			if(f->window_pos >= median_window){
+				f->window_pos = 0;
+			}
+			f->window[f->window_pos] = raw_ms;
+			f->window_pos = (f->window_pos + 1) % median_window;
+			if(f->window_len < median_window){
+				f->window_len++;
+			}
+			double sorted[FRAMETIME_FILTER_MAX_WINDOW];
+			memcpy(sorted, f->window, f->window_len * sizeof(double));
+			qsort(sorted, f->window_len, sizeof(double), compare_double);
+			filtered_ms = f->window_len % 2 ? sorted[f->window_len / 2] : (sorted[f->window_len / 2 - 1] + sorted[f->window_len / 2]) / 2;
+			break;
+		}
+		case FRAMETIME_FILTER_CLAMP:{
+			double limit = f->clamp_reference * (clamp_percent > 0 ? clamp_percent : 0) / 100;
+			if(raw_ms > f->clamp_reference + limit){
+				filtered_ms = f->clamp_reference + limit;
+				f->clamped++;
+			}else if(raw_ms < f->clamp_reference - limit){
+				filtered_ms = f->clamp_reference - limit;
+				f->clamped++;
+			}
+			// follows what was let through, so a lasting change of framerate is reached in a few steps
+			f->clamp_reference += FRAMETIME_FILTER_CLAMP_ALPHA * (filtered_ms - f->clamp_reference);
+			break;
+		}
+		default:
+			break;
+	}
+
+	f->frames++;
+	f->raw_sum += raw_ms;
+	f->raw_sq_sum += raw_ms * raw_ms;
+	if(raw_ms > f->raw_max){
+		f->raw_max = raw_ms;
+	}
+	f->filtered_sum += filtered_ms;
+	f->filtered_sq_sum += filtered_ms * filtered_ms;
+	if(filtered_ms > f->filtered_max){
+		f->filtered_max = filtered_ms;
+	}
+	if(f->frames >= FRAMETIME_FILTER_STATS_INTERVAL_FRAMES){
+		log_frametime_filter_stats(f);
+		f->frames = 0;
+		f->clamped = 0;
+		f->raw_sum = 0;
+		f->raw_sq_sum = 0;
+		f->raw_max = 0;
+		f->filtered_sum = 0;
+		f->filtered_sq_sum = 0;
+		f->filtered_max = 0;
+	}
+
+	frametime = filtered_ms;
+}
+
+// the game's top level window, found by owning process
+static HWND game_window = NULL;
+
+static BOOL CALLBACK find_game_window_callback(HWND hwnd, LPARAM param){
+	DWORD pid = 0;
+	GetWindowThreadProcessId(hwnd, &pid);
+	if(pid != GetCurrentProcessId() || !IsWindowVisible(hwnd) || GetWindow(hwnd, GW_OWNER) != NULL){
+		return true;
+	}
+	*(HWND *)param = hwnd;
+	return false;
+}
+
+static HWND find_game_window(){
+	if(game_window == NULL || !IsWindow(game_window)){
+		game_window = NULL;
+		EnumWindows(find_game_window_callback, (LPARAM)&game_window);
+	}
+	return game_window;
+}
+
+// game thread only
+static void update_game_state(const struct config_snapshot *snapshot, uint64_t now_ns){
+	static uint64_t last_window_poll_ns = 0;
+	static bool minimized = false;
+	static bool unfocused = false;
+	if(now_ns - last_window_poll_ns > GAME_STATE_WINDOW_POLL_NS){
+		last_window_poll_ns = now_ns;
+		HWND window = find_game_window();
+		minimized = window != NULL && IsIconic(window);
+		unfocused = window != NULL && GetForegroundWindow() != window;
+	}
+
+	int state;
+	if(minimized){
+		state = GAME_STATE_MINIMIZED;
+	}else if(unfocused){
+		state = GAME_STATE_UNFOCUSED;
+	}else if(last_loading_tick_ns != 0 && now_ns - last_loading_tick_ns < GAME_STATE_LOADING_HOLD_NS){
+		state = GAME_STATE_LOADING;
+	}else if(last_actor_move_ns != 0 && now_ns - last_actor_move_ns < GAME_STATE_MATCH_HOLD_NS && fetch_ctx_01642f30() != NULL){
+		state = GAME_STATE_MATCH;
+	}else{
+		state = GAME_STATE_LOBBY;
+	}
+
+	// a new snapshot can change the target as well
+	if(state == game_state){
+		select_target_frametime(snapshot);
+		return;
+	}
+	LOG("game state %s -> %s", game_state_names[game_state], game_state_names[state]);
+	game_state = state;
+	select_target_frametime(snapshot);
+
+	// the deadline keeps running, but don't sit out the rest of a longer frame after switching to a higher cap
+	if(pacer.deadline_ns != 0 && target_frametime_ns != 0 && pacer.deadline_ns > now_ns + target_frametime_ns){
+		pacer.deadline_ns = now_ns + target_frametime_ns;
+		pacer.deadline_frac = 0;
+	}
+}
+
+// raises the timer resolution while the limiter sleeps with a backend that needs it, and not in the background
+// game thread only
+static void update_limiter_timer_resolution(const struct config_snapshot *snapshot, bool limiting, uint64_t now_ns){
+	static bool requested = false;
+	static uint64_t last_needed_ns = 0;
+	bool needed = limiting && !full_busy_loop(snapshot) && sleep_backends[snapshot->sleep_backend].needs_timer_resolution &&
+		game_state != GAME_STATE_UNFOCUSED && game_state != GAME_STATE_MINIMIZED;
+	if(needed){
+		last_needed_ns = now_ns;
+		if(!requested){
+			timer_resolution_request(TIMER_RESOLUTION_USER_LIMITER, true);
+			requested = true;
+		}
+	}else if(requested && now_ns - last_needed_ns > TIMER_RESOLUTION_RELEASE_NS){
+		timer_resolution_request(TIMER_RESOLUTION_USER_LIMITER, false);
+		requested = false;
+	}
+}
+
+// game thread only
+static void update_control_status(double raw_frametime_ms, bool limiting, uint64_t tick_ns, uint64_t now_ns){
+	if(control_block == NULL){
+		return;
+	}
+	static uint64_t frame_count = 0;
+	frame_count++;
+	struct control_status status = {
+		.frame_count = frame_count,
+		.updated_ns = now_ns,
+		.frametime_ms = frametime,
+		.raw_frametime_ms = raw_frametime_ms,
+		.target_frametime_ns = target_frametime_ns,
+		.tick_ns = tick_ns,
+		.last_wake_late_ns = pacer.last_wake_late_ns,
+		.limiting = limiting,
+		.game_state = game_state,
+		.sleep_backend = tick_config.sleep_backend,
+		.pacing_mode = tick_config.config.framelimiter_pacing_mode,
+	};
+	for(int i = 0;i < CONTROL_FIX_COUNT;i++){
+		status.fix_counts[i] = __atomic_load_n(&fix_counts[i], __ATOMIC_RELAXED);
+	}
+	control_block_write_status(control_block, &status);
+}
+
 // function at 00871970, not essentially game tick
 static void (__attribute__((thiscall)) *orig_game_tick)(void *);
 void __attribute__((thiscall)) patched_game_tick(void *tick_ctx){
+	uint64_t span_ns = trace_begin();
 	LOG_VERBOSE("game tick function hook fired");
 
 
@@ -778,67 +1957,65 @@ void __attribute__((thiscall)) patched_game_tick(void *tick_ctx){
 	struct game_context *ctx = fetch_game_context();
 	LOG_VERBOSE("game context at 0x%08x", (uint32_t)ctx);
 
-	bool should_limit = ctx->fps_limiter_toggle != 0;
-
-	pthread_mutex_lock(&config_mutex);
-	if(config.max_framerate > 0 && should_limit){
-		static struct timespec last_tick = {0};
-		struct timespec this_tick;
-		clock_gettime(CLOCK_MONOTONIC, &this_tick);
-
-		#if LOG_VERBOSE
-		static uint32_t tick_count = 1;
-		#endif
-
-		if(last_tick.tv_sec != 0 || last_tick.tv_nsec != 0){
-			uint32_t diff_ns = this_tick.tv_nsec - last_tick.tv_nsec;
-			while(last_tick.tv_sec == this_tick.tv_sec && diff_ns < target_frametime_ns){
-				if(config.framelimiter_full_busy_loop){
-					// spin it all
-				}else{
-					uint32_t diff_100ns = diff_ns / 100;
-					if(target_frametime_100ns > diff_100ns + config.framelimiter_busy_loop_buffer_100ns){
-						uint32_t sleep_100ns = target_frametime_100ns - (diff_100ns + config.framelimiter_busy_loop_buffer_100ns);
-						#if LOG_VERBOSE
-						uint32_t sleep_100ns_pre_correct = sleep_100ns;
-						#endif
-						// correct to multiple of min_nt_delay_100ns
-						sleep_100ns = min_nt_delay_100ns * (sleep_100ns / min_nt_delay_100ns);
-						LOG_VERBOSE("need %u pieces of 100ns delay, corrected to %u using %u", sleep_100ns_pre_correct, sleep_100ns, min_nt_delay_100ns);
-						if(sleep_100ns > 0){
-							LOG_VERBOSE("at tick %u time %u using NtDelayExecution to delay %u pieces of 100ns", tick_count, this_tick.tv_nsec, sleep_100ns);
-							LARGE_INTEGER sleep_li;
-							sleep_li.QuadPart = sleep_100ns;
-							sleep_li.QuadPart *= -1;
-							NtDelayExecution(false, &sleep_li);
-						}
-					}
-					// spin the rest
-				}
-				clock_gettime(CLOCK_MONOTONIC, &this_tick);
-				diff_ns = this_tick.tv_nsec - last_tick.tv_nsec;
-				if(last_tick.tv_sec == this_tick.tv_sec && diff_ns < target_frametime_ns){
-					LOG_VERBOSE("spinning, diff_ns %u", diff_ns);
-				}else{
-					LOG_VERBOSE("overshot by %u + %u ns", this_tick.tv_sec - last_tick.tv_sec, diff_ns - target_frametime_ns);
-				}
-			}
-		}
-		last_tick = this_tick;
-		#if LOG_VERBOSE
-		tick_count++;
-		#endif
+	// until the deferred init is done the game keeps its own limiter
+	bool ready = __atomic_load_n(&deferred_init_done, __ATOMIC_ACQUIRE);
+	bool should_limit = ready && ctx->fps_limiter_toggle != 0;
+
+	__atomic_store_n(&game_thread_processor, (int)GetCurrentProcessorNumber(), __ATOMIC_RELAXED);
+
+	read_config_snapshot(&tick_config, &tick_config_seq);
+	const struct config *cfg = &tick_config.config;
+	uint64_t now_ns = clock_now_ns();
+	update_game_thread_mmcss(cfg);
+	update_game_state(&tick_config, now_ns);
+	update_limiter_timer_resolution(&tick_config, target_frametime_ns > 0 && should_limit, now_ns);
+	if(target_frametime_ns > 0 && should_limit){
+		struct framelimiter_settings settings = current_framelimiter_settings(&tick_config);
+		uint64_t wait_span_ns = trace_begin();
+		framelimiter_wait(&pacer, &win32_framelimiter_env, &settings);
+		trace_end("framelimiter_wait", wait_span_ns);
+	}else{
+		framelimiter_reset(&pacer);
 	}
-	pthread_mutex_unlock(&config_mutex);
 
 	uint8_t fps_limiter_toggle_orig = ctx->fps_limiter_toggle;
-	ctx->fps_limiter_toggle = 0;
+	if(ready){
+		ctx->fps_limiter_toggle = 0;
+	}
+	uint64_t tick_start_ns = clock_now_ns();
+	uint64_t tick_span_ns = trace_begin();
 	orig_game_tick(tick_ctx);
+	trace_end("orig_game_tick", tick_span_ns);
+	uint64_t tick_end_ns = clock_now_ns();
+	record_game_tick(tick_start_ns, tick_end_ns);
 	ctx->fps_limiter_toggle = fps_limiter_toggle_orig;
 
+	uint64_t delta_span_ns = trace_begin();
 	update_time_delta(&tctx);
-
-	frametime = tctx.delta_t;
+	trace_end("update_time_delta", delta_span_ns);
+	record_delta_t(tctx.delta_t);
+
+	double raw_frametime = tctx.delta_t;
+	if(cfg->high_resolution_frametime || cfg->verify_high_resolution_frametime){
+		update_high_resolution_clock(&tctx, clock_now_ns());
+		if(cfg->verify_high_resolution_frametime){
+			LOG("game clock %.3f ms, delta %.3f ms | high resolution clock %.3f ms, delta %.3f ms", tctx.last_t, tctx.delta_t, high_resolution_clock.last_t, high_resolution_clock.delta_t);
+		}
+		if(cfg->high_resolution_frametime){
+			raw_frametime = high_resolution_clock.delta_t;
+		}
+	}
+	if(cfg->fixed_frametime_ms > 0){
+		// the same every frame regardless of how long it really took, the frame limiter still sets the real pace
+		publish_frametime(cfg->fixed_frametime_ms, FRAMETIME_FILTER_RAW, 0, 0, 0);
+		spread_frametime_override = 0;
+		if(cfg->fixed_frametime_game_delta){
+			spread_frametime_override = cfg->fixed_frametime_ms < 1 ? 1 : lround(cfg->fixed_frametime_ms);
+		}
+	}else{
+		publish_frametime(raw_frametime, cfg->frametime_filter, cfg->frametime_filter_ema_alpha, cfg->frametime_filter_median_window, cfg->frametime_filter_clamp_percent);
+		spread_frametime_override = 0;
+	}
 	uint32_t frametime_uint = frametime;
 	frametime_accumulated = frametime_accumulated + frametime_uint;
 
@@ -849,8 +2026,16 @@ void __attribute__((thiscall)) patched_game_tick(void *tick_ctx){
 	// some kind of overall speed dampener
 	speed_dampeners[8] = new_speed_dampener;
 
-	LOG_VERBOSE("delta_t: %f, speed_dampener: %f", tctx.delta_t, *speed_dampener);
+	if(ready){
+		update_control_status(raw_frametime, target_frametime_ns > 0 && should_limit, tick_end_ns - tick_start_ns, tick_end_ns);
+	}
+
+	LOG_VERBOSE("delta_t: %f, speed_dampener: %f", tctx.delta_t, new_speed_dampener);
+	trace_end(__FUNCTION__, span_ns);
 }
+#undef LOG_CATEGORY
+#define LOG_CATEGORY BINLOG_CATEGORY_HOOKS
+
 static void hook_game_tick(){
 	LOG("hooking game tick");
 	uint8_t intended_trampoline[] = {
@@ -892,49 +2077,322 @@ static void experinmental_static_patches(){
 	LOG("applying experimental patches");
 }
 
-static void *main_thread(void *arg){
-	LOG("main thread started");
-	while(true){
-		sleep(2);
-		parse_config();
+#undef LOG_CATEGORY
+#define LOG_CATEGORY BINLOG_CATEGORY_CONFIG
+
+// the mapping is never closed, tools can use it for as long as the game runs
+static void init_control_block(){
+	HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(struct control_block), CONTROL_BLOCK_NAME);
+	if(mapping == NULL){
+		LOG("failed creating shared memory %s, error %lu", CONTROL_BLOCK_NAME, GetLastError());
+		return;
 	}
-	return NULL;
+	if(GetLastError() == ERROR_ALREADY_EXISTS){
+		// another client in the same session, it keeps the block
+		LOG("shared memory %s already exists, not exposing this client to tools", CONTROL_BLOCK_NAME);
+		CloseHandle(mapping);
+		return;
+	}
+	struct control_block *block = (struct control_block *)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(struct control_block));
+	if(block == NULL){
+		LOG("failed mapping shared memory %s, error %lu", CONTROL_BLOCK_NAME, GetLastError());
+		CloseHandle(mapping);
+		return;
+	}
+	control_event = CreateEventA(NULL, false, false, CONTROL_EVENT_NAME);
+	if(control_event == NULL){
+		LOG("failed creating event %s, error %lu, tools can't change the config", CONTROL_EVENT_NAME, GetLastError());
+	}
+	block->version = CONTROL_BLOCK_VERSION;
+	block->size = sizeof(struct control_block);
+	block->process_id = GetCurrentProcessId();
+	__atomic_store_n(&block->magic, CONTROL_BLOCK_MAGIC, __ATOMIC_RELEASE);
+	control_block = block;
+	LOG("exposing config and status to tools as %s, version %d", CONTROL_BLOCK_NAME, CONTROL_BLOCK_VERSION);
 }
 
+// applies what a tool wrote to the request part of the control block, main thread only
+static void apply_control_request(){
+	static uint32_t request_seq = 0;
+	struct control_config request;
+	if(!control_block_read_request(control_block, &request, &request_seq)){
+		return;
+	}
+	struct config staging_config;
+	memcpy(&staging_config, &config, sizeof(struct config));
+	control_config_apply(&staging_config, &request, "control request");
+	if(memcmp(&config, &staging_config, sizeof(struct config)) != 0){
+		LOG("applying config from control request %u", request_seq);
+		set_config(&staging_config);
+	}
+}
+
+// switches profiles by name for a tool the way a hotkey does, main thread only
+static void apply_control_profile_request(){
+	static uint32_t profile_seq = 0;
+	char name[CONFIG_PROFILE_NAME_MAX];
+	if(!control_block_read_profile_request(control_block, name, &profile_seq)){
+		return;
+	}
+	int index = -1;
+	for(int i = 0;i < profiles.count && name[0] != '\0';i++){
+		if(strcmp(profiles.profiles[i].name, name) == 0){
+			index = i;
+		}
+	}
+	if(name[0] != '\0' && index < 0){
+		LOG("control request %u asks for unknown profile %s", profile_seq, name);
+		return;
+	}
+	activate_profile(index, "control request");
+}
+
+#undef LOG_CATEGORY
+#define LOG_CATEGORY BINLOG_CATEGORY_LIMITER
+
+// only queries, the resolution is raised on demand by timer_resolution_request
 static void prepare_nt_timer(){
-	ULONG max_nt_delay_100ns;
 	ULONG current_nt_delay_100ns;
-	int i;
 	NtQueryTimerResolution(&max_nt_delay_100ns, &min_nt_delay_100ns, &current_nt_delay_100ns);
-	for(i = 0; i < 10; i++){
-		NtSetTimerResolution(min_nt_delay_100ns, true, &current_nt_delay_100ns);
-		if(min_nt_delay_100ns == current_nt_delay_100ns){
+	timer_resolution_changed_ns = clock_now_ns();
+	LOG("NtDelayExecution can have a %u * 100ns resolution accuracy, currently %u * 100ns, default %u * 100ns", min_nt_delay_100ns, current_nt_delay_100ns, max_nt_delay_100ns);
+}
+
+#undef LOG_CATEGORY
+#define LOG_CATEGORY BINLOG_CATEGORY_CONFIG
+
+// follows "logging", the writer thread starts the first time it is turned on and keeps running
+// main thread only
+static void update_logging(){
+	if(!config.logging){
+		binlog_set_mask(0);
+		return;
+	}
+	if(!binlog_writer_running && !binlog_start(LOG_FILE_NAME)){
+		binlog_set_mask(0);
+		return;
+	}
+	// in binlog_category order
+	int levels[BINLOG_CATEGORY_COUNT] = {config.log_limiter, config.log_movement, config.log_spread, config.log_fov, config.log_config, config.log_hooks};
+	binlog_set_mask(binlog_mask_for(levels));
+}
+
+static void update_tracing(){
+	if(!config.tracing){
+		trace_stop();
+		return;
+	}
+	if(trace_writer_running){
+		return;
+	}
+	// tried again after every event, only said once
+	static bool failure_logged = false;
+	if(trace_start(TRACE_FILE_NAME, "S4 League")){
+		LOG("tracing to %s", TRACE_FILE_NAME);
+		failure_logged = false;
+	}else if(!failure_logged){
+		LOG("failed starting the tracer on %s", TRACE_FILE_NAME);
+		failure_logged = true;
+	}
+}
+
+#undef LOG_CATEGORY
+#define LOG_CATEGORY BINLOG_CATEGORY_HOOKS
+
+// logs how long a startup phase took, returns the start of the next one
+static uint64_t log_init_phase(const char *phase, uint64_t start_ns){
+	uint64_t now_ns = clock_now_ns();
+	LOG("init phase %s took %.3f ms", phase, (now_ns - start_ns) / 1e6);
+	return now_ns;
+}
+
+// everything the constructor doesn't need to do under the loader lock, runs on main_thread before its loop
+// the hooks run on the defaults and the game's own limiter until it's done
+static void deferred_init(){
+	uint64_t start_ns = clock_now_ns();
+	uint64_t phase_ns = start_ns;
+
+	calibrate_clock();
+	phase_ns = log_init_phase("clock calibration", phase_ns);
+
+	init_control_block();
+	phase_ns = log_init_phase("control block", phase_ns);
+
+	// before the config, so a configured sleep_backend is checked against what this system has
+	prepare_nt_timer();
+	init_sleep_backends();
+	phase_ns = log_init_phase("timers", phase_ns);
+
+	reload_config();
+	if(config.max_framerate_auto){
+		refresh_auto_framerate();
+	}
+	update_logging();
+	update_tracing();
+	phase_ns = log_init_phase("config", phase_ns);
+
+	// after the config, it runs on the cores framelimiter_isolate_game_core leaves to main_thread
+	update_main_thread_affinity();
+	int backend = calibrate_sleep_backends();
+	pthread_mutex_lock(&config_mutex);
+	calibrated_sleep_backend = backend;
+	publish_config_snapshot();
+	pthread_mutex_unlock(&config_mutex);
+	phase_ns = log_init_phase("sleep backend calibration", phase_ns);
+
+	__atomic_store_n(&deferred_init_done, true, __ATOMIC_RELEASE);
+	log_init_phase("deferred init", start_ns);
+}
+
+// set by fini, main_thread returns when it sees it
+static HANDLE shutdown_event = NULL;
+
+// refresh rate and affinity are still polled at this interval, the config file is only read when it changes
+#define MAIN_THREAD_POLL_MS 2000
+// editors often write a file more than once when saving, wait until the changes settle
+#define CONFIG_RELOAD_DEBOUNCE_MS 100
+// but not longer than this, a file written without pause would hold the main thread forever
+#define CONFIG_RELOAD_DEBOUNCE_MAX_MS 1000
+
+// waits until the config file's size and write time stay the same for CONFIG_RELOAD_DEBOUNCE_MS
+// changes to other files in the directory don't restart the wait, false when shutdown_event fires meanwhile
+static bool wait_for_config_to_settle(HANDLE config_change){
+	uint64_t start_ns = clock_now_ns();
+	uint64_t quiet_start_ns = start_ns;
+	uint64_t size = 0;
+	uint64_t write_time = 0;
+	read_config_file_stamp(&size, &write_time);
+	HANDLE handles[2] = {shutdown_event, config_change};
+	while(true){
+		uint64_t now_ns = clock_now_ns();
+		uint64_t quiet_ms = (now_ns - quiet_start_ns) / (1000 * 1000);
+		if(quiet_ms >= CONFIG_RELOAD_DEBOUNCE_MS || now_ns - start_ns >= (uint64_t)CONFIG_RELOAD_DEBOUNCE_MAX_MS * 1000 * 1000){
+			return true;
+		}
+		DWORD wait_result = WaitForMultipleObjects(2, handles, false, CONFIG_RELOAD_DEBOUNCE_MS - quiet_ms);
+		if(wait_result == WAIT_OBJECT_0){
+			return false;
+		}
+		if(wait_result != WAIT_OBJECT_0 + 1){
+			return true;
+		}
+		FindNextChangeNotification(config_change);
+		uint64_t new_size = 0;
+		uint64_t new_write_time = 0;
+		read_config_file_stamp(&new_size, &new_write_time);
+		if(new_size != size || new_write_time != write_time){
+			size = new_size;
+			write_time = new_write_time;
+			quiet_start_ns = clock_now_ns();
+		}
+	}
+}
+
+static void *main_thread(void *arg){
+	LOG("main thread started");
+	deferred_init();
+
+	// the config file is opened relative to the working directory, so that is the directory to watch
+	HANDLE config_change = FindFirstChangeNotificationW(L".", false, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_FILE_NAME);
+	if(config_change == INVALID_HANDLE_VALUE){
+		LOG("failed watching for config changes, error %lu, checking %s every %d ms instead", GetLastError(), config_file_name, MAIN_THREAD_POLL_MS);
+		config_change = NULL;
+	}
+
+	HANDLE handles[3] = {shutdown_event};
+	DWORD handle_count = 1;
+	// 0 when not waited on, shutdown_event is always the first
+	DWORD config_change_index = 0;
+	DWORD control_index = 0;
+	if(config_change != NULL){
+		config_change_index = handle_count;
+		handles[handle_count++] = config_change;
+	}
+	if(control_event != NULL){
+		control_index = handle_count;
+		handles[handle_count++] = control_event;
+	}
+
+	uint64_t chores_ns = clock_now_ns();
+	while(true){
+		bool hotkeys = profile_hotkeys_configured();
+		DWORD wait_result = WaitForMultipleObjects(handle_count, handles, false, hotkeys ? PROFILE_HOTKEY_POLL_MS : MAIN_THREAD_POLL_MS);
+		if(wait_result == WAIT_OBJECT_0){
 			break;
-		}else{
-			LOG("NtSetTimerResolution could not set delay to minimal, trying again");
+		}
+		if(hotkeys){
+			poll_profile_hotkeys();
+		}
+		if(config_change_index != 0 && wait_result == WAIT_OBJECT_0 + config_change_index){
+			FindNextChangeNotification(config_change);
+			// the directory also holds the log and the trace, written every 100ms or faster while they're on
+			if(config_file_changed()){
+				if(!wait_for_config_to_settle(config_change)){
+					break;
+				}
+				reload_config();
+			}
+		}else if(control_index != 0 && wait_result == WAIT_OBJECT_0 + control_index){
+			// a profile first, so config values requested along with it apply on top
+			apply_control_profile_request();
+			apply_control_request();
+		}
+		update_logging();
+		update_tracing();
+
+		// with hotkeys the loop wakes far more often than the rest needs
+		uint64_t now_ns = clock_now_ns();
+		if(now_ns - chores_ns < (uint64_t)MAIN_THREAD_POLL_MS * 1000 * 1000 && wait_result == WAIT_TIMEOUT){
+			continue;
+		}
+		chores_ns = now_ns;
+		if(wait_result == WAIT_TIMEOUT && config_change == NULL){
+			reload_config();
+		}
+		update_main_thread_affinity();
+		if(config.max_framerate_auto){
+			refresh_auto_framerate();
 		}
 	}
-	LOG("NtDelayExecution now has a %u * 100ns resolution accuracy", min_nt_delay_100ns);
+
+	if(config_change != NULL){
+		FindCloseChangeNotification(config_change);
+	}
+	LOG("main thread stopping");
+	return NULL;
 }
 
+// runs under the loader lock, only installs the hooks and hands everything else to main_thread
 __attribute__((constructor))
 int init(){
-	#if ENABLE_LOGGING
-	log_file = fopen("s4_league_fps_unlock.log", "w");
-	if(pthread_mutex_init(&log_mutex, NULL)){
-		printf("logger mutex init failed\n");
-		return 0;
+	init_clock();
+	// startup is recorded at the default levels either way, it stays in memory unless the config turns logging on
+	if(binlog_init(clock_now_ns)){
+		int levels[BINLOG_CATEGORY_COUNT] = {config_defaults.log_limiter, config_defaults.log_movement, config_defaults.log_spread, config_defaults.log_fov, config_defaults.log_config, config_defaults.log_hooks};
+		binlog_set_mask(binlog_mask_for(levels));
 	}
-	#endif // ENABLE_LOGGING
+	trace_init(clock_now_ns);
+	binlog_writer_wake = follow_background_affinity;
+	trace_writer_wake = follow_background_affinity;
 
 	if(pthread_mutex_init(&config_mutex, NULL)){
 		printf("config mutex init failed\n");
 		return 0;
 	}
 
+	if(pthread_mutex_init(&timer_resolution_mutex, NULL)){
+		printf("timer resolution mutex init failed\n");
+		return 0;
+	}
+
 	LOG("mhmm library loaded");
 
-	parse_config();
+	uint64_t start_ns = clock_now_ns();
+
+	// snapshot of the defaults for the hooks, parse_config only publishes again when the file differs
+	pthread_mutex_lock(&config_mutex);
+	publish_config_snapshot();
+	pthread_mutex_unlock(&config_mutex);
 
 	redirect_speed_dampeners();
 
@@ -947,13 +2405,44 @@ int init(){
 	hook_calculate_weapon_spread();
 
 	experinmental_static_patches();
+	uint64_t phase_ns = log_init_phase("hooks", start_ns);
 
-	LOG("now starting main thread");
+	// the thread only starts running once the loader lock is released
+	shutdown_event = CreateEventW(NULL, true, false, NULL);
 	pthread_t thread;
 	pthread_create(&thread, NULL, main_thread, NULL);
+	log_init_phase("main thread start", phase_ns);
 
-	prepare_nt_timer();
-
+	log_init_phase("constructor", start_ns);
 	LOG("gcc constructor ending");
 	return 0;
 }
+
+__attribute__((destructor))
+void fini(){
+	// not joined, that can deadlock under the loader lock, it leaves on its own
+	if(shutdown_event != NULL){
+		SetEvent(shutdown_event);
+	}
+
+	// give the timer resolution back when the game unloads us or exits
+	// at process exit the other threads are gone wherever they were, one may have died holding the mutex
+	if(pthread_mutex_trylock(&timer_resolution_mutex) == 0){
+		timer_resolution_users = 0;
+		apply_timer_resolution(false);
+		timer_resolution_time_ns[timer_resolution_raised] += clock_now_ns() - timer_resolution_changed_ns;
+		timer_resolution_changed_ns = clock_now_ns();
+		log_timer_resolution_usage();
+		pthread_mutex_unlock(&timer_resolution_mutex);
+	}else{
+		// the bookkeeping can't be trusted then, release both anyway, releasing what isn't held only fails
+		ULONG current_nt_delay_100ns;
+		NtSetTimerResolution(min_nt_delay_100ns, false, &current_nt_delay_100ns);
+		timeEndPeriod(1);
+		LOG("timer resolution mutex busy at exit, released the timer resolution without it");
+	}
+	LOG("gcc destructor ending");
+	// the writers may never run again, hand over what is left
+	binlog_flush();
+	trace_flush();
+}
@@ -0,0 +1,216 @@
+// span tracer, begin and end of what each frame spends its time on, written out as chrome trace event json
+// the file opens directly in ui.perfetto.dev or chrome://tracing
+// header only, the asi and trace_check.cpp share it
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+// spans held between two flushes, a power of 2, more than this many per flush are dropped
+#define TRACE_SPANS 65536
+#define TRACE_FLUSH_MS 100
+
+// one finished span, seq is its position + 1 once the rest is written, the writer waits for it
+struct trace_slot{
+	uint32_t seq;
+	uint32_t thread;
+	// a string literal of the call site
+	const char *name;
+	uint64_t begin_ns;
+	uint64_t end_ns;
+};
+
+static bool trace_enabled = false;
+static uint64_t (*trace_now_ns)() = NULL;
+
+// every thread adds to the same ring, positions count spans and wrap freely
+static struct trace_slot *trace_slots = NULL;
+static uint32_t trace_head = 0;
+static uint32_t trace_tail = 0;
+static uint32_t trace_dropped = 0;
+
+#ifndef _WIN32
+static __thread uint32_t trace_thread = 0;
+#endif
+
+// a begin timestamp, 0 while tracing is off, so trace_end knows to skip the span
+__attribute__((always_inline)) static inline uint64_t trace_begin(){
+	if(__builtin_expect(!__atomic_load_n(&trace_enabled, __ATOMIC_ACQUIRE), 1)){
+		return 0;
+	}
+	return trace_now_ns();
+}
+
+static inline uint32_t trace_thread_id(){
+	#ifdef _WIN32
+	return GetCurrentThreadId();
+	#else
+	if(trace_thread == 0){
+		trace_thread = syscall(SYS_gettid);
+	}
+	return trace_thread;
+	#endif
+}
+
+static void trace_record(const char *name, uint64_t begin_ns){
+	uint64_t end_ns = trace_now_ns();
+	uint32_t head = __atomic_load_n(&trace_head, __ATOMIC_RELAXED);
+	do{
+		if(head - __atomic_load_n(&trace_tail, __ATOMIC_ACQUIRE) >= TRACE_SPANS){
+			__atomic_fetch_add(&trace_dropped, 1, __ATOMIC_RELAXED);
+			return;
+		}
+	}while(!__atomic_compare_exchange_n(&trace_head, &head, head + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	struct trace_slot *slot = &trace_slots[head & (TRACE_SPANS - 1)];
+	slot->thread = trace_thread_id();
+	slot->name = name;
+	slot->begin_ns = begin_ns;
+	slot->end_ns = end_ns;
+	__atomic_store_n(&slot->seq, head + 1, __ATOMIC_RELEASE);
+}
+
+// ends a span begun with trace_begin, name has to outlive the trace, eg. a literal
+__attribute__((always_inline)) static inline void trace_end(const char *name, uint64_t begin_ns){
+	if(__builtin_expect(begin_ns != 0, 0)){
+		trace_record(name, begin_ns);
+	}
+}
+
+// writer side
+static FILE *trace_file = NULL;
+static pthread_mutex_t trace_writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t trace_writer_thread;
+static bool trace_writer_running = false;
+static bool trace_writer_stop = false;
+// called on the writer thread before each drain when set, the asi keeps the writer off the game core with it
+static void (*trace_writer_wake)() = NULL;
+// timestamps in the file count from here, in microseconds
+static uint64_t trace_base_ns = 0;
+static uint32_t trace_dropped_written = 0;
+
+// every event after the first starts with a comma
+// the closing bracket is never written, trace viewers allow that so the file stays readable when the game dies
+static void trace_emit_separator(){
+	static bool first = true;
+	fputs(first ? "\n" : ",\n", trace_file);
+	first = false;
+}
+
+static bool trace_drain(){
+	bool wrote = false;
+	uint32_t tail = __atomic_load_n(&trace_tail, __ATOMIC_RELAXED);
+	while(true){
+		struct trace_slot *slot = &trace_slots[tail & (TRACE_SPANS - 1)];
+		if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != tail + 1){
+			break;
+		}
+		struct trace_slot span = *slot;
+		__atomic_store_n(&trace_tail, ++tail, __ATOMIC_RELEASE);
+		trace_emit_separator();
+		fprintf(trace_file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", span.name, span.thread,
+			(int64_t)(span.begin_ns - trace_base_ns) / 1000.0, (span.end_ns - span.begin_ns) / 1000.0);
+		wrote = true;
+	}
+	uint32_t dropped = __atomic_load_n(&trace_dropped, __ATOMIC_RELAXED);
+	if(dropped != trace_dropped_written){
+		trace_emit_separator();
+		fprintf(trace_file, "{\"name\":\"spans dropped\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"args\":{\"total\":%u}}",
+			(int64_t)(trace_now_ns() - trace_base_ns) / 1000.0, dropped);
+		trace_dropped_written = dropped;
+		wrote = true;
+	}
+	return wrote;
+}
+
+// drains the ring once, skipped when the writer is busy or died holding the lock, eg. at process exit
+static void trace_flush(){
+	if(trace_file == NULL || pthread_mutex_trylock(&trace_writer_mutex) != 0){
+		return;
+	}
+	trace_drain();
+	fflush(trace_file);
+	pthread_mutex_unlock(&trace_writer_mutex);
+}
+
+static void *trace_writer(void *arg){
+	while(!__atomic_load_n(&trace_writer_stop, __ATOMIC_RELAXED)){
+		if(trace_writer_wake != NULL){
+			trace_writer_wake();
+		}
+		pthread_mutex_lock(&trace_writer_mutex);
+		if(trace_drain()){
+			fflush(trace_file);
+		}
+		pthread_mutex_unlock(&trace_writer_mutex);
+		#ifdef _WIN32
+		Sleep(TRACE_FLUSH_MS);
+		#else
+		struct timespec delay = {0, TRACE_FLUSH_MS * 1000 * 1000};
+		nanosleep(&delay, NULL);
+		#endif
+	}
+	trace_flush();
+	return NULL;
+}
+
+// call once before tracing, now_ns stamps every span
+static void trace_init(uint64_t (*now_ns)()){
+	trace_now_ns = now_ns;
+}
+
+// the first time allocates the ring and opens the file, process_name names the process in the viewer
+// then starts the writer and turns spans on
+static bool trace_start(const char *path, const char *process_name){
+	if(trace_writer_running){
+		return true;
+	}
+	if(trace_file == NULL){
+		trace_slots = (struct trace_slot *)calloc(TRACE_SPANS, sizeof(struct trace_slot));
+		if(trace_slots == NULL){
+			return false;
+		}
+		trace_file = fopen(path, "wb");
+		if(trace_file == NULL){
+			free(trace_slots);
+			trace_slots = NULL;
+			return false;
+		}
+		trace_base_ns = trace_now_ns();
+		fputs("[", trace_file);
+		trace_emit_separator();
+		fprintf(trace_file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"%s\"}}", process_name);
+	}
+	trace_writer_stop = false;
+	if(pthread_create(&trace_writer_thread, NULL, trace_writer, NULL) != 0){
+		return false;
+	}
+	trace_writer_running = true;
+	__atomic_store_n(&trace_enabled, true, __ATOMIC_RELEASE);
+	return true;
+}
+
+// turns spans off, stops and joins the writer after a last drain, the file stays open for a later trace_start
+// spans already begun still end into the ring and go out with the next flush
+static void trace_stop(){
+	__atomic_store_n(&trace_enabled, false, __ATOMIC_RELAXED);
+	if(!trace_writer_running){
+		return;
+	}
+	__atomic_store_n(&trace_writer_stop, true, __ATOMIC_RELAXED);
+	pthread_join(trace_writer_thread, NULL);
+	trace_writer_running = false;
+}
+
+#endif
@@ -0,0 +1,258 @@
+// checks the span tracer in trace.h on the linux build host, threads play the game thread and the hooks
+// then times a span with tracing off and on
+// build with build_tools.sh, run with --help for options
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <time.h>
+
+#include "trace.h"
+
+static int checks = 0;
+static int failed = 0;
+
+static void check(bool ok, const char *what){
+	checks++;
+	if(!ok){
+		failed++;
+		printf("  failed: %s\n", what);
+	}
+}
+
+static uint64_t now_ns(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+#define CHECK_THREADS 4
+#define CHECK_FRAMES 2000
+
+// a frame like patched_game_tick's, the hook runs inside orig_game_tick
+static void *trace_frames(void *arg){
+	for(int i = 0;i < CHECK_FRAMES;i++){
+		uint64_t frame_ns = trace_begin();
+		uint64_t tick_ns = trace_begin();
+		uint64_t hook_ns = trace_begin();
+		trace_end("patched_move_actor_by", hook_ns);
+		trace_end("orig_game_tick", tick_ns);
+		trace_end("patched_game_tick", frame_ns);
+	}
+	return NULL;
+}
+
+struct trace_counts{
+	int events;
+	int frames;
+	int ticks;
+	int hooks;
+	int dropped_events;
+	uint32_t dropped;
+	int malformed;
+};
+
+// reads the file the way it is laid out, one event per line
+static bool read_trace(const char *path, struct trace_counts *counts){
+	memset(counts, 0, sizeof(struct trace_counts));
+	FILE *file = fopen(path, "rb");
+	if(file == NULL){
+		return false;
+	}
+	char line[512];
+	bool first = true;
+	while(fgets(line, sizeof(line), file) != NULL){
+		size_t len = strlen(line);
+		if(first){
+			first = false;
+			if(strcmp(line, "[\n") != 0){
+				counts->malformed++;
+			}
+			continue;
+		}
+		while(len > 0 && (line[len - 1] == '\n' || line[len - 1] == ',')){
+			line[--len] = '\0';
+		}
+		if(len < 2 || line[0] != '{' || line[len - 1] != '}'){
+			counts->malformed++;
+			continue;
+		}
+		counts->events++;
+		char name[64];
+		uint32_t tid;
+		double ts;
+		double dur;
+		if(sscanf(line, "{\"name\":\"%63[^\"]\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lf,\"dur\":%lf}", name, &tid, &ts, &dur) == 4){
+			if(strcmp(name, "patched_game_tick") == 0){
+				counts->frames++;
+			}else if(strcmp(name, "orig_game_tick") == 0){
+				counts->ticks++;
+			}else if(strcmp(name, "patched_move_actor_by") == 0){
+				counts->hooks++;
+			}
+			continue;
+		}
+		if(sscanf(line, "{\"name\":\"spans dropped\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%lf,\"args\":{\"total\":%u}}", &ts, &counts->dropped) == 2){
+			counts->dropped_events++;
+			continue;
+		}
+		if(strncmp(line, "{\"name\":\"process_name\",\"ph\":\"M\"", 31) != 0){
+			counts->malformed++;
+		}
+	}
+	fclose(file);
+	return !first;
+}
+
+// spans are written as they end, so each hook comes right before the tick around it on its thread
+static bool check_nesting(const char *path){
+	FILE *file = fopen(path, "rb");
+	if(file == NULL){
+		return false;
+	}
+	char line[512];
+	struct{
+		uint32_t tid;
+		double ts;
+		double dur;
+	}last_hooks[CHECK_THREADS] = {};
+	bool nested = true;
+	while(fgets(line, sizeof(line), file) != NULL){
+		char name[64];
+		uint32_t tid;
+		double ts;
+		double dur;
+		if(sscanf(line, "{\"name\":\"%63[^\"]\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lf,\"dur\":%lf}", name, &tid, &ts, &dur) != 4){
+			continue;
+		}
+		int slot = 0;
+		while(slot < CHECK_THREADS - 1 && last_hooks[slot].tid != 0 && last_hooks[slot].tid != tid){
+			slot++;
+		}
+		if(strcmp(name, "patched_move_actor_by") == 0){
+			last_hooks[slot].tid = tid;
+			last_hooks[slot].ts = ts;
+			last_hooks[slot].dur = dur;
+		}else if(strcmp(name, "orig_game_tick") == 0){
+			// the file rounds to the nanosecond
+			nested = nested && last_hooks[slot].tid == tid && last_hooks[slot].ts >= ts - 0.001 && last_hooks[slot].ts + last_hooks[slot].dur <= ts + dur + 0.002;
+		}
+	}
+	fclose(file);
+	return nested;
+}
+
+static void check_threads(const char *path){
+	check(trace_begin() == 0, "no spans before trace_start");
+	check(trace_start(path, "trace_check"), "tracer starts");
+	pthread_t threads[CHECK_THREADS];
+	for(int i = 0;i < CHECK_THREADS;i++){
+		pthread_create(&threads[i], NULL, trace_frames, NULL);
+	}
+	for(int i = 0;i < CHECK_THREADS;i++){
+		pthread_join(threads[i], NULL);
+	}
+	trace_stop();
+	check(trace_begin() == 0, "no spans after trace_stop");
+	uint32_t head = trace_head;
+	trace_frames(NULL);
+	check(trace_head == head, "spans while off don't reach the ring");
+
+	struct trace_counts counts;
+	check(read_trace(path, &counts), "the trace reads back");
+	check(counts.malformed == 0, "one event per line, the file is an array of them");
+	check(counts.frames == CHECK_THREADS * CHECK_FRAMES && counts.ticks == counts.frames && counts.hooks == counts.frames, "every span of every thread is written");
+	check(check_nesting(path), "spans nest as they ran");
+}
+
+// the writer doesn't run, so the ring fills up
+static void check_full_ring(const char *path){
+	__atomic_store_n(&trace_enabled, true, __ATOMIC_RELEASE);
+	for(int i = 0;i < TRACE_SPANS + 100;i++){
+		trace_end("filling", trace_begin());
+	}
+	__atomic_store_n(&trace_enabled, false, __ATOMIC_RELAXED);
+	check(trace_dropped == 100, "a full ring drops spans instead of blocking");
+	trace_flush();
+	struct trace_counts counts;
+	read_trace(path, &counts);
+	check(counts.dropped_events == 1 && counts.dropped == 100, "dropped spans are reported in the trace");
+	check(counts.events == 1 + CHECK_THREADS * CHECK_FRAMES * 3 + TRACE_SPANS + 1, "the full ring is written out");
+}
+
+// rounds of half a ring, the flush between them isn't timed, in the asi it runs on the writer thread
+__attribute__((noinline)) static void time_spans(int iterations, const char *label){
+	uint64_t spent_ns = 0;
+	for(int done = 0;done < iterations;done += TRACE_SPANS / 2){
+		uint64_t start_ns = now_ns();
+		for(int i = 0;i < TRACE_SPANS / 2;i++){
+			uint64_t span_ns = trace_begin();
+			__asm__ volatile("" ::: "memory");
+			trace_end("timed", span_ns);
+		}
+		spent_ns += now_ns() - start_ns;
+		trace_flush();
+	}
+	int rounds = (iterations + TRACE_SPANS / 2 - 1) / (TRACE_SPANS / 2);
+	printf("%-32s %8.2f ns/span\n", label, (double)spent_ns / ((uint64_t)rounds * (TRACE_SPANS / 2)));
+}
+
+static void bench(int iterations){
+	time_spans(iterations, "tracing off");
+	__atomic_store_n(&trace_enabled, true, __ATOMIC_RELEASE);
+	time_spans(iterations, "tracing on");
+	__atomic_store_n(&trace_enabled, false, __ATOMIC_RELAXED);
+	// the 100 of check_full_ring stay the only ones
+	check(trace_dropped == 100, "nothing more dropped while timing");
+}
+
+static void usage(const char *argv0){
+	printf("usage: %s [options]\n", argv0);
+	printf("  --file PATH          trace to write and read back, default trace_check.json, removed afterwards\n");
+	printf("  --iterations N       spans per timing, default 1000000\n");
+	printf("  --check              only check, skip the timing\n");
+}
+
+int main(int argc, char **argv){
+	const char *path = "trace_check.json";
+	int iterations = 1000000;
+	bool check_only = false;
+	for(int i = 1;i < argc;i++){
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+		if(strcmp(arg, "--check") == 0){
+			check_only = true;
+			continue;
+		}
+		if(strcmp(arg, "--help") == 0){
+			usage(argv[0]);
+			return 0;
+		}
+		if(value == NULL){
+			fprintf(stderr, "%s needs a value\n", arg);
+			return 1;
+		}
+		if(strcmp(arg, "--file") == 0){
+			path = value;
+		}else if(strcmp(arg, "--iterations") == 0){
+			iterations = atoi(value);
+		}else{
+			fprintf(stderr, "unknown option %s\n", arg);
+			usage(argv[0]);
+			return 1;
+		}
+		i++;
+	}
+
+	trace_init(now_ns);
+	check_threads(path);
+	check_full_ring(path);
+	if(!check_only){
+		bench(iterations);
+	}
+	remove(path);
+	printf("%d of %d checks passed\n", checks - failed, checks);
+	return failed != 0;
+}